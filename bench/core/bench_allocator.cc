@@ -0,0 +1,69 @@
+#include "core/allocator.h"
+#include "core/runtime.h"
+#include <chrono>
+#include <random>
+
+// Replays a synthetic alloc/free trace against every Allocator policy and
+// reports the replay time and the resulting arena peak.
+//
+// usage: bench_allocator [numAllocs] [maxLiveBlocks]
+
+namespace infini {
+
+struct TraceEvent {
+    bool isAlloc;
+    size_t id;
+    size_t size;
+};
+
+static vector<TraceEvent> makeTrace(size_t numAllocs, size_t maxLive) {
+    std::mt19937_64 rng(2024);
+    // log-uniform sizes between 64B and 1MB, like a mix of activations
+    std::uniform_real_distribution<double> logSize(6.0, 20.0);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    vector<TraceEvent> trace;
+    vector<pair<size_t, size_t>> live;
+    for (size_t id = 0; id < numAllocs; ++id) {
+        size_t size = (size_t)std::exp2(logSize(rng));
+        trace.push_back({true, id, size});
+        live.emplace_back(id, size);
+        while (live.size() > maxLive || (!live.empty() && coin(rng) < 0.45)) {
+            size_t victim = rng() % live.size();
+            trace.push_back({false, live[victim].first, live[victim].second});
+            live[victim] = live.back();
+            live.pop_back();
+        }
+    }
+    return trace;
+}
+
+static void replay(const char *name, AllocPolicy policy,
+                   const vector<TraceEvent> &trace, size_t numAllocs) {
+    Allocator allocator(NativeCpuRuntimeObj::getInstance(), policy);
+    vector<size_t> offsets(numAllocs);
+    auto begin = std::chrono::steady_clock::now();
+    for (auto &event : trace) {
+        if (event.isAlloc)
+            offsets[event.id] = allocator.alloc(event.size);
+        else
+            allocator.free(offsets[event.id], event.size);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - begin).count();
+    printf("%-10s %10.2f ms %14zu bytes peak\n", name, ms, allocator.getPeak());
+}
+
+} // namespace infini
+
+int main(int argc, char **argv) {
+    using namespace infini;
+    size_t numAllocs = argc > 1 ? std::stoul(argv[1]) : 50000;
+    size_t maxLive = argc > 2 ? std::stoul(argv[2]) : 20000;
+    auto trace = makeTrace(numAllocs, maxLive);
+    printf("%zu allocations, %zu events, at most %zu live blocks\n", numAllocs,
+           trace.size(), maxLive);
+    replay("FirstFit", AllocPolicy::FirstFit, trace, numAllocs);
+    replay("BestFit", AllocPolicy::BestFit, trace, numAllocs);
+    replay("WorstFit", AllocPolicy::WorstFit, trace, numAllocs);
+    return 0;
+}
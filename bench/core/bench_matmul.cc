@@ -0,0 +1,155 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "operators/matmul.h"
+#include <algorithm>
+#include <chrono>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Runs square Float32 Matmuls of growing size on the CPU runtime, and
+// reports GFLOPS next to the peak of the widest FMA unit the CPU has, as
+// measured by a loop of independent FMAs on every thread. Then reports the
+// p50/p99 latency of batch-1 shapes (M = 1), which take the GEMV path.
+//
+// usage: bench_matmul [maxSize]
+
+namespace infini {
+
+#if defined(__x86_64__)
+__attribute__((target("avx512f"))) static float fmaLoopAvx512(size_t iters) {
+    __m512 acc[12], x = _mm512_set1_ps(0.999f), y = _mm512_set1_ps(1e-3f);
+    for (int i = 0; i < 12; ++i)
+        acc[i] = _mm512_set1_ps(i);
+    for (size_t it = 0; it < iters; ++it)
+#pragma GCC unroll 12
+        for (int i = 0; i < 12; ++i)
+            acc[i] = _mm512_fmadd_ps(acc[i], x, y);
+    for (int i = 1; i < 12; ++i)
+        acc[0] = _mm512_add_ps(acc[0], acc[i]);
+    float out[16];
+    _mm512_storeu_ps(out, acc[0]);
+    return out[0];
+}
+
+__attribute__((target("avx2,fma"))) static float fmaLoopAvx2(size_t iters) {
+    __m256 acc[12], x = _mm256_set1_ps(0.999f), y = _mm256_set1_ps(1e-3f);
+    for (int i = 0; i < 12; ++i)
+        acc[i] = _mm256_set1_ps(i);
+    for (size_t it = 0; it < iters; ++it)
+#pragma GCC unroll 12
+        for (int i = 0; i < 12; ++i)
+            acc[i] = _mm256_fmadd_ps(acc[i], x, y);
+    float out[8];
+    for (int i = 1; i < 12; ++i)
+        acc[0] = _mm256_add_ps(acc[0], acc[i]);
+    _mm256_storeu_ps(out, acc[0]);
+    return out[0];
+}
+#endif
+
+// Peak GFLOPS of all threads, or 0 if the CPU has neither unit.
+static double peakGflops() {
+    size_t lanes = 0;
+    float (*loop)(size_t) = nullptr;
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx512f"))
+        lanes = 16, loop = fmaLoopAvx512;
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        lanes = 8, loop = fmaLoopAvx2;
+#endif
+    if (!loop)
+        return 0;
+    const size_t iters = 50000000;
+    volatile float sink = 0;
+    double seconds = 0;
+#pragma omp parallel reduction(max : seconds)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        sink = sink + loop(iters);
+        auto end = std::chrono::steady_clock::now();
+        seconds = std::chrono::duration<double>(end - begin).count();
+    }
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    return 2.0 * 12 * lanes * iters * threads / seconds * 1e-9;
+}
+
+static double run(size_t size) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    int dim = size;
+    auto a = g->addTensor({dim, dim}, DataType::Float32);
+    auto b = g->addTensor({dim, dim}, DataType::Float32);
+    g->addOp<MatmulObj>(a, b, nullptr);
+    g->dataMalloc();
+    auto fill = [](void *data, size_t n, DataType) {
+        for (size_t i = 0; i < n; ++i)
+            reinterpret_cast<float *>(data)[i] = float(i % 17) / 17;
+    };
+    a->setData(fill);
+    b->setData(fill);
+    runtime->run(g); // warm up
+    int reps = std::max(1, int(2e9 / (2.0 * size * size * size)));
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; ++i)
+        runtime->run(g);
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - begin).count();
+    return 2.0 * size * size * size * reps / seconds * 1e-9;
+}
+
+// Latency percentiles of an m x k by k x n Matmul over many runs, and the
+// bandwidth of reading B at the median.
+static void runLatency(int m, int k, int n) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto a = g->addTensor({m, k}, DataType::Float32);
+    auto b = g->addTensor({k, n}, DataType::Float32);
+    g->addOp<MatmulObj>(a, b, nullptr);
+    g->dataMalloc();
+    auto fill = [](void *data, size_t size, DataType) {
+        for (size_t i = 0; i < size; ++i)
+            reinterpret_cast<float *>(data)[i] = float(i % 17) / 17;
+    };
+    a->setData(fill);
+    b->setData(fill);
+    runtime->run(g); // warm up
+    vector<double> us(200);
+    for (auto &t : us) {
+        auto begin = std::chrono::steady_clock::now();
+        runtime->run(g);
+        auto end = std::chrono::steady_clock::now();
+        t = std::chrono::duration<double, std::micro>(end - begin).count();
+    }
+    std::sort(us.begin(), us.end());
+    double p50 = us[us.size() / 2], p99 = us[us.size() * 99 / 100];
+    printf("%4dx%5dx%5d p50 %9.1f us p99 %9.1f us %7.1f GB/s\n", m, k, n,
+           p50, p99, 4.0 * k * n / p50 * 1e-3);
+}
+
+} // namespace infini
+
+int main(int argc, char **argv) {
+    using namespace infini;
+    size_t maxSize = argc > 1 ? std::stoul(argv[1]) : 2048;
+    double peak = peakGflops();
+    printf("peak %10.1f GFLOPS\n", peak);
+    for (size_t size = 64; size <= maxSize; size *= 2) {
+        double gflops = run(size);
+        printf("%5zu^3 %10.1f GFLOPS", size, gflops);
+        if (peak > 0)
+            printf(" %6.1f%% of peak", 100 * gflops / peak);
+        printf("\n");
+    }
+    for (int size : {1024, 4096})
+        runLatency(1, size, size);
+    runLatency(1, 4096, 11008);
+    runLatency(4, 4096, 4096);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "operators/element_wise.h"
+#include <chrono>
+#include <random>
+
+// Sorts random DAGs of growing size whose operators were added in shuffled
+// order, and reports the time of GraphObj::topo_sort under every policy.
+//
+// usage: bench_topo_sort [maxOps]
+
+namespace infini {
+
+static Graph makeGraph(size_t numOps, std::mt19937_64 &rng) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    // tensor k is produced by op k - 1; op k reads two earlier tensors
+    TensorVec tensors;
+    tensors.reserve(numOps + 1);
+    for (size_t k = 0; k <= numOps; ++k)
+        tensors.push_back(g->addTensor({1, 16}, DataType::Float32));
+    vector<size_t> perm(numOps);
+    for (size_t k = 0; k < numOps; ++k)
+        perm[k] = k;
+    std::shuffle(perm.begin(), perm.end(), rng);
+    for (auto k : perm) {
+        // mostly local edges with an occasional long skip, like real models
+        size_t lhs = k;
+        size_t rhs = k - std::min(k, (size_t)(rng() % 8));
+        if (rng() % 16 == 0)
+            rhs = rng() % (k + 1);
+        Tensor out = tensors[k + 1];
+        g->addOpWithOutputs<AddObj>(tensors[lhs], tensors[rhs], out);
+    }
+    return g;
+}
+
+static void run(const char *name, TopoSortPolicy policy, size_t numOps) {
+    std::mt19937_64 rng(2024);
+    Graph g = makeGraph(numOps, rng);
+    g->setSortPolicy(policy);
+    auto begin = std::chrono::steady_clock::now();
+    bool ok = g->topo_sort();
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - begin).count();
+    printf("%-12s %9zu ops %12.2f ms %s\n", name, numOps, ms,
+           ok ? "" : "(failed)");
+}
+
+} // namespace infini
+
+int main(int argc, char **argv) {
+    using namespace infini;
+    size_t maxOps = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    for (size_t numOps = 1000; numOps <= maxOps; numOps *= 10) {
+        run("Original", TopoSortPolicy::Original, numOps);
+        run("MemoryFirst", TopoSortPolicy::MemoryFirst, numOps);
+        run("CriticalPath", TopoSortPolicy::CriticalPath, numOps);
+    }
+    return 0;
+}
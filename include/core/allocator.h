@@ -6,9 +6,27 @@
 #endif
 #include <cstddef>
 #include <map>
+#include <set>
 #include <unordered_set>
 
 namespace infini {
+  // Which free block alloc() picks among those large enough
+  enum class AllocPolicy
+  {
+    FirstFit, // lowest address, O(n) walk over the free blocks
+    BestFit,  // smallest block, O(log n)
+    WorstFit, // largest block, O(log n)
+  };
+
+  // A buffer whose lifetime is known before allocation: it is live from step
+  // `begin` to step `end`, both inclusive.
+  struct MemoryRequest
+  {
+    size_t size;
+    int begin;
+    int end;
+  };
+
   class Allocator
   {
   private:
@@ -20,6 +38,8 @@ namespace infini {
 
     size_t alignment;
 
+    AllocPolicy policy;
+
     // pointer to the memory actually allocated
     void *ptr;
 
@@ -29,9 +49,12 @@ namespace infini {
     // =================================== 作业 ===================================
     //空闲内存块
     std::map<size_t, size_t> free_blocks; //key为block的起始地址，value为block的大小
+    // the same free blocks indexed by (size, address), kept in sync with
+    // free_blocks, for best-fit and worst-fit lookups
+    std::set<std::pair<size_t, size_t>> free_blocks_by_size;
 
   public:
-    Allocator(Runtime runtime);
+    Allocator(Runtime runtime, AllocPolicy policy = AllocPolicy::BestFit);
 
     virtual ~Allocator();
 
@@ -51,11 +74,42 @@ namespace infini {
     // return: pointer to the head address of the allocated memory
     void *getPtr();
 
+    // function: release the memory and forget all allocations, so that the
+    //           allocator can be used for a new plan
+    void reset();
+
+    // function: size of the arena required by the allocations so far
+    size_t getPeak() const { return peak; }
+
+    // function: allocate the requests online, step by step: at each step
+    //           the buffers that begin there are allocated, then the ones
+    //           that end there are freed
+    // return: head address offset of each request
+    vector<size_t> replay(const vector<MemoryRequest> &requests);
+
+    // function: plan the requests offline, greedy by size: the largest
+    //           buffers are placed first, each into the tightest gap left
+    //           by the placed buffers whose lifetimes overlap its own
+    // return: head address offset of each request
+    vector<size_t> plan(const vector<MemoryRequest> &requests);
+
+    // function: lower bound of any arena for the requests, i.e. the
+    //           maximum number of bytes live at the same step
+    size_t getLowerBound(const vector<MemoryRequest> &requests);
+
     void info();
 
   private:
     // function: memory alignment, rouned up
     // return: size of the aligned memory block
     size_t getAlignedSize(size_t size);
+
+    // function: find a free block of at least `size` bytes by the policy
+    // return: iterator into free_blocks, or free_blocks.end() if none fits
+    std::map<size_t, size_t>::iterator findFreeBlock(size_t size);
+
+    void insertFreeBlock(size_t addr, size_t size);
+
+    void eraseFreeBlock(std::map<size_t, size_t>::iterator it);
   };
 }
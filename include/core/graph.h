@@ -2,12 +2,56 @@
 #include "core/allocator.h"
 #include "core/operator.h"
 #include "core/tensor.h"
+#include "core/weight_file.h"
 #include <algorithm>
 #include <cstdint>
 
 namespace infini
 {
 
+    /**
+     * @brief How GraphObj::dataMalloc assigns arena offsets to tensors.
+     */
+    enum class MemoryStrategy
+    {
+        Online,  // replay alloc/free through the Allocator in execution order
+        Offline, // plan all tensor lifetimes at once, see Allocator::plan
+    };
+
+    /**
+     * @brief Which of the ready operators GraphObj::topo_sort places first.
+     */
+    enum class TopoSortPolicy
+    {
+        Original,     // the one that became ready first, then added first
+        MemoryFirst,  // the one freeing the most bytes net of its outputs
+        CriticalPath, // the one with the most work left on a path after it
+    };
+
+    /**
+     * @brief Memory footprint of the last GraphObj::dataMalloc.
+     */
+    struct MemoryStats
+    {
+        size_t weightBytes = 0;     // size of the persistent weight pool
+        size_t constantBytes = 0;   // constants made by folding and rewrites
+        size_t tensorBytes = 0;     // sum of the sizes of all activations
+        size_t arenaBytes = 0;      // arena size of the chosen strategy
+        size_t onlineBytes = 0;     // arena size of the online strategy
+        size_t lowerBoundBytes = 0; // maximum bytes live at the same step
+    };
+
+    /**
+     * @brief What one rewrite rule did during GraphObj::optimize.
+     */
+    struct RewriteStats
+    {
+        string name;
+        size_t matches = 0; // the pattern matched
+        size_t hits = 0;    // the rewrite changed the graph
+        double ms = 0;      // time spent matching and rewriting
+    };
+
     class GraphObj : public Object
     {
     protected:
@@ -15,47 +59,155 @@ namespace infini
         TensorVec tensors; //图中所有的张量
         OpVec ops; //图中所有的算子
         Allocator allocator; //内存分配器（作业一要用！）
+        Allocator weightAllocator; // 权重的持久内存池
+        TensorVec pooledWeights; // 放在权重内存池中的权重
+        vector<WeightFile> weightFiles; // 权重直接指向这些文件的映射
+        vector<pair<Tensor, void *>> foldedConstants; // 常量折叠和改写产生的常量及其内存
+        optional<vector<UidBaseType>> weightOrder; // 第一次改写前的权重，权重文件按此编号
+        MemoryStats memoryStats;
 
     public:
         explicit GraphObj(Runtime runtime)
-            : runtime(runtime), allocator(runtime), sorted(false){};
+            : runtime(runtime), allocator(runtime), weightAllocator(runtime),
+              sorted(false){};
+        ~GraphObj();
         string toString() const override;
         Runtime getRuntime() const { return runtime; } //获取运行时环境
 
         Tensor addTensor(Shape dim, DataType dtype = DataType::Float32); //添加新张量
         Tensor addTensor(const Tensor &tensor); //添加已有张量
         TensorVec addTensor(const TensorVec &tensors); //批量添加
-        void removeOperator(Operator op)
-        {
-            auto it = std::find(ops.begin(), ops.end(), op);
-            if (it != ops.end())
-                ops.erase(it);
-        }
+        /**
+         * @brief Add a weight whose memory is owned by the graph, for
+         * constants created by rewrites. The caller fills the data.
+         */
+        Tensor addConstant(Shape dim, DataType dtype = DataType::Float32);
+        /**
+         * @brief Remove one operator or tensor from the containers, keeping the
+         * order of the others. The lookup is O(1) but the removal shifts the
+         * elements after it; use removeOperators/removeTensors to remove many.
+         * Connections are not touched.
+         */
+        void removeOperator(Operator op) { removeOperators({op}); }
+        void removeTensor(Tensor tensor) { removeTensors({tensor}); }
 
-        void removeTensor(Tensor tensor)
-        {
-            auto it = std::find(tensors.begin(), tensors.end(), tensor);
-            if (it != tensors.end())
-                tensors.erase(it);
-        }
+        /**
+         * @brief Remove a batch of operators or tensors in a single compacting
+         * pass, O(size of the graph + size of the batch).
+         */
+        void removeOperators(const OpVec &toRemove);
+        void removeTensors(const TensorVec &toRemove);
+
+        /**
+         * @brief Make `op` read `to` instead of `from`, updating the edges of
+         * the graph. `from` is removed if nothing is connected to it anymore.
+         */
+        void replaceInput(const Operator &op, const Tensor &from,
+                          const Tensor &to);
+
+        /**
+         * @brief Make every consumer of `from` read `to` instead.
+         */
+        void replaceAllUses(const Tensor &from, const Tensor &to);
+
+        /**
+         * @brief Disconnect `op` and remove it, together with the tensors
+         * left with neither a source nor a target. Outputs that still have
+         * consumers are kept, so a replacement producer added before the call
+         * keeps them alive.
+         */
+        void eraseOperator(const Operator &op);
 
         const TensorVec &getTensors() const { return tensors; }
         const OpVec &getOperators() const { return ops; }
-        Tensor getTensor(int) const;
+        Tensor getTensor(int) const; // O(1)
+        bool hasOperator(const Operator &op) const
+        {
+            return opIndex.count(op.get()) != 0;
+        }
+        bool hasTensor(const Tensor &tensor) const;
 
         /**
-         * @brief Sort the nodes in topological order.
+         * @brief Sort the nodes in topological order, in O(V + E) for the
+         * Original policy and O(V + E log V) for the others, which keep the
+         * ready nodes in a heap. Ties between ready nodes are broken by the
+         * sort policy.
          * It returns true if the sorting is successful.
          * Otherwise false is returned, means that there are rings in the graph,
          * so the topological sorting fails.
          */
         bool topo_sort(); //拓扑排序
 
-        void optimize(); //图优化
+        void setSortPolicy(TopoSortPolicy policy)
+        {
+            if (policy != sortPolicy)
+                sorted = false;
+            sortPolicy = policy;
+        }
+
+        /**
+         * @brief 图优化. Nothing is printed.
+         * @return The stats of every rule of every phase, in order, after
+         * an entry "CommonSubexpressionElimination" whose hits count the
+         * merged operators.
+         */
+        vector<RewriteStats> optimize();
+
+        /**
+         * @brief The operators `outputs` depend on, in topological order.
+         */
+        OpVec getProducers(const TensorVec &outputs);
+
+        /**
+         * @brief Dead code elimination: remove the operators `outputs` do not
+         * depend on, with the tensors only they used. Other graph outputs,
+         * e.g. debugging heads, go away with their producers.
+         * @return The number of operators removed.
+         */
+        size_t eliminateDeadCode(const TensorVec &outputs);
 
         void shape_infer(); //形状推断
 
-        void dataMalloc(); //分配内存
+        /**
+         * @brief Allocate memory and bind every tensor to it. Weights go to a
+         * persistent pool on the first call and keep their memory afterwards.
+         * Activations are planned in an arena where tensors whose lifetimes do
+         * not overlap share memory; calling it again, e.g. after shape_infer,
+         * re-plans the activations only.
+         */
+        void dataMalloc(MemoryStrategy strategy = MemoryStrategy::Online); //分配内存
+        const MemoryStats &getMemoryStats() const { return memoryStats; }
+
+        /**
+         * @brief Run once every operator whose inputs are all weights with
+         * data, e.g. a Transpose of a weight, with the registered kernels.
+         * Their outputs become weights holding the results and the folded
+         * operators, with the intermediates, leave the graph. Call it once
+         * the weights are loaded; dataMalloc afterwards plans a smaller
+         * arena.
+         * @return The number of operators folded.
+         */
+        size_t foldConstants();
+
+        /**
+         * @brief Bind the weights of this graph found in the weight file at
+         * `path` directly to its read-only mapping, see WeightFileObj. Weights
+         * are numbered in the order they were added, as they were before the
+         * first optimize or foldConstants: rewrites erasing or creating
+         * constants do not renumber them, so a file fits the model before and
+         * after optimization. Every weight still in the graph must be in the
+         * file with the same data type and shape, or loading fails. Weights
+         * bound this way are not allocated by dataMalloc.
+         * @return The number of weights bound.
+         */
+        size_t loadWeights(const string &path);
+
+        /**
+         * @brief Write the weights of this graph, which must all have data,
+         * to a weight file that loadWeights of the same model reads back.
+         * Weights erased by rewrites are left out.
+         */
+        void saveWeights(const string &path) const;
 
         /**
          * @brief Add an operator and create its outputs. Output tensor arguments
@@ -104,7 +256,13 @@ namespace infini
             return ret;
         }
 
-        bool checkValid() const;
+        /**
+         * @brief Check the connections of the graph in O(V + E), see the
+         * rules in graph.cc. With `incremental` only the nodes added, removed
+         * or next to a removed node since the last check are visited, which
+         * misses edits made directly on operators and tensors.
+         */
+        bool checkValid(bool incremental = false) const;
 
     private:
         /**
@@ -112,10 +270,65 @@ namespace infini
          */
         void addOperatorAndConnect(const Operator &op);
 
+        /**
+         * @brief Bind `tensor` to memory freed with the graph and make it a
+         * weight.
+         */
+        void bindConstant(const Tensor &tensor);
+
+        /**
+         * @brief Add or remove the edges between `op` and its inputs.
+         */
+        void connectInputs(const Operator &op);
+        void disconnectInputs(const Operator &op);
+
+        /**
+         * @brief Allocate the weights that do not have data yet.
+         */
+        void weightMalloc();
+
+        /**
+         * @brief Free the memory of the constants that have left the graph:
+         * those created by folding or by rewrites are freed, and the weight
+         * pool is repacked without the weights rewrites erased.
+         */
+        void releaseDeadConstants();
+
+        /**
+         * @brief Fix the numbering of the weights used by weight files, once,
+         * before rewrites erase or create constants.
+         */
+        void freezeWeightOrder();
+
+        /**
+         * @brief The weights by their number in weight files, nullptr for
+         * those rewrites erased.
+         */
+        TensorVec getNumberedWeights() const;
+
         /**
          * @brief If the nodes is sorted in topological order.
          */
         bool sorted;
+
+        TopoSortPolicy sortPolicy = TopoSortPolicy::Original;
+
+        /**
+         * @brief Positions in `ops` and `tensors`, kept in sync with them.
+         */
+        std::unordered_map<OperatorObj *, size_t> opIndex;
+        std::unordered_map<UidBaseType, size_t> tensorIndex;
+        void reindexOperators(size_t from = 0);
+        void reindexTensors(size_t from = 0);
+
+        /**
+         * @brief Nodes to visit in the next incremental checkValid.
+         */
+        mutable OpVec dirtyOps;
+        mutable TensorVec dirtyTensors;
+        mutable bool dirtyAll = false; // too many edits, check everything
+        void touch(const Operator &op);
+        void touch(const Tensor &tensor);
     };
 
 } // namespace infini
@@ -0,0 +1,135 @@
+#pragma once
+#include "core/graph.h"
+#include <functional>
+
+namespace infini
+{
+    /**
+     * @brief A subgraph pattern rooted at one operator. It matches the root
+     * op by type and predicates, and recursively the producers of selected
+     * inputs, e.g. a Transpose whose input comes from another Transpose:
+     *
+     *   Pattern(OpType::Transpose).input(0, Pattern(OpType::Transpose))
+     */
+    class Pattern
+    {
+    public:
+        using Predicate = std::function<bool(const Operator &)>;
+
+    private:
+        optional<OpType> type; // any type if empty
+        vector<Predicate> predicates;
+        vector<pair<size_t, Pattern>> inputs;
+        bool single = false;
+
+    public:
+        Pattern() = default;
+        Pattern(OpType type) : type(type) {}
+
+        /**
+         * @brief The matched op must also satisfy `pred`. Predicates run
+         * after the producers matched, so they may look at them.
+         */
+        Pattern &where(Predicate pred);
+
+        /**
+         * @brief Input `index` of the matched op must be produced by an op
+         * matching `producer`.
+         */
+        Pattern &input(size_t index, Pattern producer);
+
+        /**
+         * @brief Every output of the matched op must have a single consumer
+         * op, so that the op is dead once that consumer is rewritten.
+         */
+        Pattern &singleUse();
+
+        optional<OpType> getRootType() const { return type; }
+
+        /**
+         * @brief Try to match `op`. On success the matched ops are appended
+         * to `matched` in pre-order: the root first, then the producers in
+         * the order their input() calls were made.
+         */
+        bool match(const Operator &op, OpVec &matched) const;
+    };
+
+    /**
+     * @brief A rewrite replacing the subgraph matched by `pattern`. The
+     * rewrite gets the matched ops and returns whether it changed the graph;
+     * it may still bail out, e.g. on a case the pattern cannot express.
+     * Rewrites edit the graph through GraphObj::replaceInput,
+     * GraphObj::replaceAllUses, GraphObj::eraseOperator and GraphObj::addOp.
+     */
+    struct RewriteRule
+    {
+        string name;
+        Pattern pattern;
+        std::function<bool(GraphObj &, const OpVec &)> rewrite;
+    };
+
+    /**
+     * @brief Applies a set of rules to a graph until none of them applies.
+     *
+     * Ops wait in a worklist, seeded with the whole graph in topological
+     * order. Only rules whose root type is the op's type are tried on it.
+     * After a hit, the ops around the rewritten subgraph are queued again,
+     * and once the worklist drains a final sweep over the graph confirms the
+     * fixpoint.
+     */
+    class RewriteEngine
+    {
+    private:
+        vector<RewriteRule> rules;
+        vector<RewriteStats> stats;
+        std::unordered_map<OpType::underlying_t, vector<size_t>> rulesByType;
+        vector<size_t> anyTypeRules;
+
+    public:
+        RewriteEngine() = default;
+        explicit RewriteEngine(vector<RewriteRule> rules);
+
+        RewriteEngine &addRule(RewriteRule rule);
+
+        /**
+         * @brief Rewrite `graph` to a fixpoint.
+         * @return The number of rewrites applied.
+         */
+        size_t run(GraphObj &graph);
+
+        const vector<RewriteStats> &getStats() const { return stats; }
+        void printStats() const;
+
+    private:
+        bool tryRules(GraphObj &graph, const Operator &op, OpVec &touched);
+    };
+
+    /**
+     * @brief Common subexpression elimination. Operators hashed by type,
+     * OperatorObj::getOpAttrVector and input tensors are merged into the
+     * first of them in topological order, and the consumers of the others
+     * are rewired. Ops writing a graph output, on either side of a
+     * merge, are kept.
+     * @return The number of operators removed.
+     */
+    size_t eliminateCommonSubexpressions(GraphObj &graph);
+
+    /**
+     * @brief Horizontal fusion of independent Matmuls of the same shape and
+     * batch rank >= 3 into one Matmul over their matrices concatenated along
+     * axis 0, followed by a Split. Each A, and each B unless all are
+     * constants, must be produced by the graph so that the Concat costs no
+     * copy; constant Bs are concatenated once into a new constant. Runs once
+     * per GraphObj::optimize, after the rule phases. Defined in
+     * rewrite_rules.cc.
+     * @return The number of Matmuls merged away.
+     */
+    size_t batchIndependentMatmuls(GraphObj &graph);
+
+    /**
+     * @brief The rule sets of GraphObj::optimize, run one after another, each
+     * to a fixpoint. Defined in rewrite_rules.cc.
+     */
+    vector<vector<RewriteRule>> getOptimizePhases();
+
+} // namespace infini
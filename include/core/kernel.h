@@ -21,6 +21,17 @@ namespace infini
          */
         virtual void compute(const Operator &op,
                              const RuntimeObj *context) const = 0;
+
+        /**
+         * @brief Whether the output of the op may share the buffer of its
+         * input `index`. A kernel may return true if every output element is
+         * written only after the elements of that input at the same position
+         * have been read, and no other position of that input is read later.
+         */
+        virtual bool supportsInPlace(const Operator &op, size_t index) const
+        {
+            return false;
+        }
     };
 
     class KernelRegistry
@@ -59,6 +70,10 @@ namespace infini
                                                "}");
             return std::get<0>(it->second);
         }
+        bool hasKernel(const KernelAttrs &kernelAttrs) const
+        {
+            return kernels.find(kernelAttrs) != kernels.end();
+        }
         const KernelRecord &getKernelItem(const KernelAttrs &kernelAttrs) const
         {
             return kernels.at(kernelAttrs);
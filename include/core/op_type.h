@@ -24,6 +24,8 @@ namespace infini
             Relu,
             Sub,
             Transpose,
+            FusedElementWise,
+            Split,
 
         } type;
 
@@ -55,6 +55,13 @@ namespace infini
         virtual int numInputs() const = 0; //获取输入张量数量
         virtual int numOutputs() const = 0; //获取输出张量数量
 
+        /**
+         * @brief The operator type followed by every attribute that affects
+         * the result, but not the inputs. Two operators with equal attribute
+         * vectors compute the same outputs from the same inputs.
+         */
+        virtual vector<int> getOpAttrVector() const = 0;
+
         /**
          * @brief Clone this operator and replace its inputs and outputs.
          *
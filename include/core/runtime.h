@@ -38,6 +38,10 @@ namespace infini
     virtual ~RuntimeObj() {}
 
     virtual void run(const Graph &graph) const = 0;
+    /**
+     * @brief Compute only `outputs`, running the operators they depend on.
+     */
+    virtual void run(const Graph &graph, const TensorVec &outputs) const = 0;
     virtual void *alloc(size_t size) = 0;
     virtual void dealloc(void *ptr) = 0;
 
@@ -46,11 +50,21 @@ namespace infini
       return true;
     }
 
+    Device getDevice() const { return device; }
+
     virtual string toString() const = 0;
   };
 
   class NativeCpuRuntimeObj : public RuntimeObj
   {
+    // alignment of the memory returned by alloc, a power of two
+    size_t alignment = 64;
+    // whether alloc zero-fills the memory
+    bool zeroFill = false;
+    // allocations of at least this many bytes are aligned to huge pages and
+    // advised to be backed by transparent huge pages, 0 disables it
+    size_t hugePageThreshold = 32 << 20;
+
   public:
     NativeCpuRuntimeObj() : RuntimeObj(Device::CPU) {}
 
@@ -62,8 +76,32 @@ namespace infini
     }
     void dealloc(void *ptr) override;
     void run(const Graph &graph) const override;
+    void run(const Graph &graph, const TensorVec &outputs) const override;
+    /**
+     * @brief Allocate `size` bytes aligned to the configured alignment. The
+     * memory is uninitialized unless setZeroFill(true) was called: kernels
+     * write every element of their outputs and must not rely on zeros, as
+     * the activation arena hands out recycled memory anyway.
+     */
     void *alloc(size_t size) override;
     string toString() const override;
+
+    void setAlignment(size_t alignment);
+    /**
+     * @brief Whether alloc zero-fills the memory, off by default.
+     */
+    void setZeroFill(bool zeroFill) { this->zeroFill = zeroFill; }
+    void setHugePageThreshold(size_t bytes) { hugePageThreshold = bytes; }
+
+    /**
+     * @brief Bytes of the mapping containing `ptr` that are currently backed
+     * by transparent huge pages. Pages are only backed once touched, so
+     * query it after the first run. Always 0 where THP is not available.
+     */
+    static size_t getHugePageBytes(void *ptr);
+
+  private:
+    void runOperators(const OpVec &ops) const;
   };
 
 } // namespace infini
@@ -25,6 +25,7 @@ namespace infini
         WRef<OperatorObj> source; // 产生这个 tensor 的算子（弱引用）
         Blob data; //实际数据存储（指向内存块）
         Runtime runtime; //元素总数 = 1×2×2×3 = 12
+        bool weight = false; // 是否为权重（常量），权重不参与激活内存的复用
 
     private:
         Shape shape;    // 形状，如 {1, 2, 2, 3}
@@ -49,6 +50,14 @@ namespace infini
             std::function<void(void *, size_t, DataType)> const &generator) const;
 
         void setDataBlob(const Blob &blob);
+        bool hasData() const { return data != nullptr; }
+
+        /**
+         * @brief Mark the tensor as a weight. Weights are constants: they live
+         * in a persistent pool that is never recycled or re-planned.
+         */
+        void setWeight() { weight = true; }
+        bool isWeight() const { return weight; }
 
         void printData() const;
         bool equalData(const Tensor &rhs, double relativeError = 1e-6) const;
@@ -0,0 +1,89 @@
+#pragma once
+#include "core/tensor.h"
+
+namespace infini
+{
+    /**
+     * @brief A binary weight file mapped read-only into memory, so that
+     * weight tensors can point straight into the mapping without copying.
+     * Processes mapping the same file share its pages in the page cache.
+     *
+     * Entries are keyed by the number of the weight in its graph, see
+     * GraphObj::loadWeights, which is the same in every process that builds
+     * the model. FUIDs are not: they come from a process-wide counter. The
+     * header records how many weights the model has, so a file of another
+     * model fails to load instead of binding a same-shape weight to the
+     * wrong tensor.
+     *
+     * Layout, in host byte order:
+     *   Header                     magic, version, count, slots, alignment
+     *   WeightEntry[count]         one per tensor, keyed by its number among
+     *                              the `slots` weights of the graph
+     *   data                       each tensor at `offset`, aligned to
+     *                              `alignment` from the start of the file
+     */
+    class WeightFileObj
+    {
+    public:
+        static constexpr char magic[8] = {'I', 'T', 'W', 'E',
+                                          'I', 'G', 'H', 'T'};
+        static constexpr uint32_t version = 4;
+        static constexpr int maxRank = 8;
+
+        struct Header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t count;  // entries in the file
+            uint64_t slots;  // weights of the model, some may be left out
+            uint64_t alignment;
+        };
+
+        struct WeightEntry
+        {
+            int32_t index; // number of the weight in its graph
+            int32_t dtype; // DataType index
+            int32_t rank;
+            int32_t dims[maxRank];
+            uint64_t offset;
+            uint64_t bytes;
+        };
+
+    private:
+        void *base;
+        size_t length;
+        size_t slots;
+        std::unordered_map<size_t, const WeightEntry *> entries;
+
+    public:
+        /**
+         * @brief Map the file at `path` read-only.
+         */
+        explicit WeightFileObj(const string &path);
+        WeightFileObj(const WeightFileObj &) = delete;
+        WeightFileObj &operator=(const WeightFileObj &) = delete;
+        ~WeightFileObj();
+
+        /**
+         * @brief Write the data of `weights` into a new weight file, the i-th
+         * of them as entry i. Null weights are left out but keep their
+         * number. Pass the weights of a graph by number, as
+         * GraphObj::saveWeights does.
+         */
+        static void save(const string &path, const TensorVec &weights,
+                         size_t alignment = 64);
+
+        /**
+         * @brief Pointer to the data of entry `index`, for `tensor`, inside
+         * the mapping, or nullptr if the file does not contain it. The shape
+         * and data type must match the tensor. The memory is read-only.
+         */
+        void *getData(size_t index, const Tensor &tensor) const;
+
+        size_t size() const { return entries.size(); }
+        size_t getSlots() const { return slots; }
+    };
+
+    using WeightFile = Ref<WeightFileObj>;
+
+} // namespace infini
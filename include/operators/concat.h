@@ -25,6 +25,7 @@ class ConcatObj : public OperatorObj {
     optional<vector<Shape>> inferShape(const TensorVec &inputs) override;
 
     std::string toString() const override;
+    vector<int> getOpAttrVector() const override;
     int numInputs() const override { return inputs.size(); }
     int numOutputs() const override { return 1; }
     int getDim() const { return dim; }
@@ -0,0 +1,55 @@
+#pragma once
+#include "core/operator.h"
+
+namespace infini {
+/**
+ * @brief One step of a FusedElementWiseObj program. Registers 0 to
+ * numInputs - 1 hold the inputs, and the k-th instruction writes register
+ * numInputs + k, so every register is written once.
+ */
+struct ElementWiseInstr {
+    enum Code : uint8_t { Add, Sub, Mul, Div, Relu, Clip };
+    Code code;
+    int a, b = -1; // operand registers, b is unused by unary codes
+    std::optional<float> min = std::nullopt, max = std::nullopt; // Clip
+
+    bool isUnary() const { return code == Relu || code == Clip; }
+    bool operator==(const ElementWiseInstr &rhs) const {
+        return code == rhs.code && a == rhs.a && b == rhs.b &&
+               min == rhs.min && max == rhs.max;
+    }
+};
+
+/**
+ * @brief A chain or tree of Add/Sub/Mul/Div/Relu/Clip evaluated in a single
+ * pass over the output. The inputs broadcast to the output shape like those
+ * of ElementWiseObj, and the output is the register written last. The output
+ * may have another data type than the inputs, for a Cast fused into the op;
+ * the program computes in the input type and converts on the final store.
+ */
+class FusedElementWiseObj : public OperatorObj {
+    vector<ElementWiseInstr> program;
+
+  public:
+    /**
+     * @brief Construct a new FusedElementWise object.
+     *
+     * @param graph The computation graph that this operator belongs to.
+     * @param inputs The input tensors, registers 0 to inputs.size() - 1.
+     * @param output The output tensor.
+     * @param program The instructions, at least one.
+     */
+    FusedElementWiseObj(GraphObj *graph, TensorVec inputs, Tensor output,
+                        vector<ElementWiseInstr> program);
+    OP_CLONE(FusedElementWiseObj);
+
+    optional<vector<Shape>> inferShape(const TensorVec &inputs) override;
+
+    std::string toString() const override;
+    vector<int> getOpAttrVector() const override;
+    int numInputs() const override { return inputs.size(); }
+    int numOutputs() const override { return 1; }
+    const vector<ElementWiseInstr> &getProgram() const { return program; }
+    int numRegisters() const { return inputs.size() + program.size(); }
+};
+} // namespace infini
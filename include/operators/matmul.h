@@ -3,6 +3,16 @@
 
 namespace infini
 {
+    /**
+     * @brief The activation applied by an operator to its output.
+     */
+    enum class ActType
+    {
+        None,
+        Relu,
+        Clip, // clamp to the optional bounds of the operator
+    };
+
     /**
      * @brief Matrix multiplication.
      *
@@ -15,6 +25,12 @@ namespace infini
         // oppsite to the column-major BLAS.
         bool transA, transB;
 
+        // The epilogue, applied to the output as it is computed:
+        // C = act(A * B + bias). The bias is the optional third input and
+        // broadcasts to the last two dimensions of C.
+        ActType act;
+        std::optional<float> minValue, maxValue;
+
         // Auxiliary attributes which are not a part of operator attributes.
         int m, n, k;
 
@@ -37,12 +53,20 @@ namespace infini
          * the constructor, C should be an empty Ref.
          * @param transA If matrix A should be transposed when computing.
          * @param transB If matrix B should be transposed when computing.
+         * @param bias The optional bias, added to every matrix of C.
+         * @param act The activation of the output.
+         * @param min The lower bound of ActType::Clip.
+         * @param max The upper bound of ActType::Clip.
          */
         MatmulObj(GraphObj *graph, Tensor A, Tensor B, Tensor C,
-                  bool transA = false, bool transB = false);
+                  bool transA = false, bool transB = false,
+                  Tensor bias = nullptr, ActType act = ActType::None,
+                  std::optional<float> min = std::nullopt,
+                  std::optional<float> max = std::nullopt);
         OP_CLONE(MatmulObj);
 
         std::string toString() const override;
+        vector<int> getOpAttrVector() const override;
         optional<vector<Shape>> inferShape(const TensorVec &inputs) override;
 
         int numInputs() const override { return inputs.size(); }
@@ -52,6 +76,11 @@ namespace infini
         bool getTransB() const { return transB; }
         void setTransA(bool transA) { this->transA = transA; }
         void setTransB(bool transB) { this->transB = transB; }
+        Tensor getBias() const { return inputs.size() > 2 ? inputs[2] : nullptr; }
+        ActType getAct() const { return act; }
+        std::optional<float> getMin() const { return minValue; }
+        std::optional<float> getMax() const { return maxValue; }
+        bool hasEpilogue() const { return getBias() || act != ActType::None; }
         int getM() const { return m; }
         int getN() const { return n; }
         int getK() const { return k; }
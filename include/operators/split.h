@@ -0,0 +1,40 @@
+#pragma once
+#include "core/operator.h"
+
+namespace infini {
+/**
+ * @brief Split a tensor into several along one dimension, the inverse of
+ * ConcatObj. When the dims before the split axis are all 1, every output is
+ * a contiguous range of the input and dataMalloc places it there, so the
+ * split copies nothing.
+ *
+ */
+class SplitObj : public OperatorObj {
+    int dim;
+    vector<int> sizes;
+
+  public:
+    /**
+     * @brief Construct a new Split object.
+     *
+     * @param graph The computation graph that this operator belongs to.
+     * @param input The input tensor.
+     * @param outputs The output tensors, or std::nullopt to create them.
+     * @param dim The dimension to split on.
+     * @param sizes The size of each output along `dim`, summing up to the
+     * size of the input.
+     */
+    SplitObj(GraphObj *graph, Tensor input, std::optional<TensorVec> outputs,
+             int dim, vector<int> sizes);
+    OP_CLONE(SplitObj);
+
+    optional<vector<Shape>> inferShape(const TensorVec &inputs) override;
+
+    std::string toString() const override;
+    vector<int> getOpAttrVector() const override;
+    int numInputs() const override { return 1; }
+    int numOutputs() const override { return sizes.size(); }
+    int getDim() const { return dim; }
+    const vector<int> &getSizes() const { return sizes; }
+};
+} // namespace infini
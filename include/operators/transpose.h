@@ -24,9 +24,14 @@ namespace infini
     optional<vector<Shape>> inferShape(const TensorVec &inputs) override;
 
     std::string toString() const override;
+    vector<int> getOpAttrVector() const override;
     int numInputs() const override { return 1; }
     int numOutputs() const override { return 1; }
     std::vector<int> getPermute() const { return transposePermute; }
+    /**
+     * @brief Replace the permutation. The output shape must stay the same.
+     */
+    void setPermute(vector<int> permute);
 
   private:
     vector<int> transposePermute;
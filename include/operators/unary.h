@@ -22,6 +22,7 @@ namespace infini
     optional<vector<Shape>> inferShape(const TensorVec &inputs) override;
 
     std::string toString() const override;
+    vector<int> getOpAttrVector() const override;
     int numInputs() const override { return 1; }
     int numOutputs() const override { return 1; }
   };
@@ -35,6 +36,7 @@ namespace infini
     optional<vector<Shape>> inferShape(const TensorVec &inputs) override;
 
     std::string toString() const override;
+    vector<int> getOpAttrVector() const override;
     std::optional<float> getMin() const { return minValue; };
     std::optional<float> getMax() const { return maxValue; };
     int numInputs() const override { return 1; }
@@ -82,6 +84,7 @@ namespace infini
     vector<DataType> inferDataType(const TensorVec &inputs) const override;
 
     std::string toString() const override;
+    vector<int> getOpAttrVector() const override;
     CastType getType() const { return castType; }
     DataType getOutputDataType() const;
     int numInputs() const override { return 1; }
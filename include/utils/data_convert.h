@@ -0,0 +1,65 @@
+#pragma once
+#ifndef DATA_CONVERT_H
+#define DATA_CONVERT_H
+
+#include "core/data_type.h"
+
+namespace infini {
+
+// Whether CPU kernels can convert elements of `dtype` with a plain C++ cast.
+// Float16 and BFloat16 have no arithmetic type to convert through.
+inline bool is_convertible(DataType dtype) {
+    switch (dtype.getIndex()) {
+    case 1:  // DataType::Float32
+    case 2:  // DataType::UInt8
+    case 3:  // DataType::Int8
+    case 4:  // DataType::UInt16
+    case 5:  // DataType::Int16
+    case 6:  // DataType::Int32
+    case 7:  // DataType::Int64
+    case 11: // DataType::Double
+    case 12: // DataType::UInt32
+    case 13: // DataType::UInt64
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Call `f` with a value of the C++ type of `dtype`, one of the types for
+// which is_convertible holds, e.g.
+//   dispatch_convertible(dtype, [&](auto tag) { using T = decltype(tag); });
+template <typename F> void dispatch_convertible(DataType dtype, F &&f) {
+#define CASE(N)                                                                \
+    case N:                                                                    \
+        f(typename DT<N>::t{});                                                \
+        break
+
+    switch (dtype.getIndex()) {
+        CASE(1);
+        CASE(2);
+        CASE(3);
+        CASE(4);
+        CASE(5);
+        CASE(6);
+        CASE(7);
+        CASE(11);
+        CASE(12);
+        CASE(13);
+    default:
+        IT_TODO_HALT_MSG("Cannot convert " + dtype.toString());
+    }
+#undef CASE
+}
+
+// Convert `n` elements from `src` to `dst`, e.g. for a kernel that writes
+// another type than it computes in.
+template <typename TIn, typename TOut>
+void convert_data(const TIn *src, TOut *dst, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = static_cast<TOut>(src[i]);
+}
+
+} // namespace infini
+
+#endif
@@ -1,10 +1,13 @@
 #include "core/allocator.h"
+#include <algorithm>
+#include <numeric>
 #include <utility>
 // Trigger CI rebuild
 
 namespace infini
 {
-    Allocator::Allocator(Runtime runtime) : runtime(runtime)
+    Allocator::Allocator(Runtime runtime, AllocPolicy policy)
+        : runtime(runtime), policy(policy)
     {
         used = 0;
         peak = 0;
@@ -35,39 +38,39 @@ namespace infini
         // =================================== 作业 ===================================
         
         // 优先查找够大的空闲块
-        for(auto it = free_blocks.begin(); it != free_blocks.end(); it++)
+        auto it = findFreeBlock(size);
+        if (it != free_blocks.end())
         {
-            if(it->second >= size)
+            size_t addr = it->first;
+            size_t blockSize = it->second;
+            eraseFreeBlock(it);
+            if (blockSize > size)
             {
-                size_t addr = it->first;
-                if(it->second > size)
-                {
-                    free_blocks[addr + size] = it->second - size;
-                }
-                free_blocks.erase(it);
-                return addr;
+                insertFreeBlock(addr + size, blockSize - size);
             }
+            return addr;
         }
-        
+
         // 检查末尾是否有空闲块可以扩展
         if (!free_blocks.empty())
         {
-            auto it = std::prev(free_blocks.end());  // 最后一个空闲块
-            if (it->first + it->second == used)  // 如果这个块在末尾
+            auto last = std::prev(free_blocks.end()); // 最后一个空闲块
+            if (last->first + last->second == used)   // 如果这个块在末尾
             {
-                size_t addr = it->first;
-                size_t extra = size - it->second;  // 需要额外分配的大小
-                free_blocks.erase(it);
-                used += extra;  // 扩展末尾
-                if (used > peak) peak = used;
+                size_t addr = last->first;
+                size_t extra = size - last->second; // 需要额外分配的大小
+                eraseFreeBlock(last);
+                used += extra; // 扩展末尾
+                if (used > peak)
+                    peak = used;
                 return addr;
             }
         }
-        
+
         // 从末尾分配新空间
         size_t addr = used;
         used += size;
-        if(used > peak)
+        if (used > peak)
         {
             peak = used;
         }
@@ -82,39 +85,159 @@ namespace infini
         // =================================== 作业 ===================================
         // TODO: 设计一个算法来回收内存
         // =================================== 作业 ===================================
-        free_blocks[addr] = size;
-        auto it = free_blocks.find(addr); //it为free_blocks中addr的迭代器
+        auto next = free_blocks.lower_bound(addr);
+        //后顾
+        if (next != free_blocks.end() && addr + size == next->first)
+        {
+            size += next->second;
+            eraseFreeBlock(next);
+        }
         //前瞻
-        if(it != free_blocks.begin())
+        auto it = free_blocks.lower_bound(addr);
+        if (it != free_blocks.begin())
         {
             auto prev = std::prev(it);
-            size_t prev_addr = prev->first;
-            size_t prev_size = prev->second;
-            if(prev_addr + prev_size == addr)
+            if (prev->first + prev->second == addr)
             {
-                addr = prev_addr;
-                size += prev_size;
-                free_blocks.erase(prev);     
-                free_blocks.erase(it);           
-                free_blocks[addr] = size;
+                addr = prev->first;
+                size += prev->second;
+                eraseFreeBlock(prev);
             }
         }
-        //后顾
-        auto it2  = free_blocks.find(addr);
-        auto next = std::next(it2);
-        if(next != free_blocks.end())
+        insertFreeBlock(addr, size);
+    }
+
+    std::map<size_t, size_t>::iterator Allocator::findFreeBlock(size_t size)
+    {
+        switch (policy)
         {
-            size_t next_addr = next->first;
-            size_t next_size = next->second;
-            if(addr + size == next_addr)
+        case AllocPolicy::FirstFit:
+            for (auto it = free_blocks.begin(); it != free_blocks.end(); ++it)
             {
-                size += next_size;
-                free_blocks.erase(next);            
-                free_blocks[addr] = size;
+                if (it->second >= size)
+                    return it;
             }
+            return free_blocks.end();
+        case AllocPolicy::BestFit:
+        {
+            auto it = free_blocks_by_size.lower_bound({size, 0});
+            if (it == free_blocks_by_size.end())
+                return free_blocks.end();
+            return free_blocks.find(it->second);
+        }
+        case AllocPolicy::WorstFit:
+        {
+            if (free_blocks_by_size.empty() ||
+                free_blocks_by_size.rbegin()->first < size)
+                return free_blocks.end();
+            // among the largest blocks prefer the lowest address
+            auto it = free_blocks_by_size.lower_bound(
+                {free_blocks_by_size.rbegin()->first, 0});
+            return free_blocks.find(it->second);
+        }
+        default:
+            IT_TODO_HALT();
+        }
+    }
+
+    void Allocator::insertFreeBlock(size_t addr, size_t size)
+    {
+        free_blocks[addr] = size;
+        free_blocks_by_size.emplace(size, addr);
+    }
+
+    void Allocator::eraseFreeBlock(std::map<size_t, size_t>::iterator it)
+    {
+        free_blocks_by_size.erase({it->second, it->first});
+        free_blocks.erase(it);
+    }
+
+    vector<size_t> Allocator::replay(const vector<MemoryRequest> &requests)
+    {
+        int lastStep = 0;
+        for (auto &request : requests)
+            lastStep = std::max(lastStep, request.end);
+        vector<vector<size_t>> allocAt(lastStep + 1), freeAt(lastStep + 1);
+        for (size_t i = 0; i < requests.size(); ++i)
+        {
+            allocAt[requests[i].begin].emplace_back(i);
+            if (requests[i].end < lastStep)
+                freeAt[requests[i].end].emplace_back(i);
+        }
+        vector<size_t> offsets(requests.size());
+        for (int step = 0; step <= lastStep; ++step)
+        {
+            for (auto i : allocAt[step])
+                offsets[i] = alloc(requests[i].size);
+            for (auto i : freeAt[step])
+                free(offsets[i], requests[i].size);
         }
+        return offsets;
+    }
 
+    vector<size_t> Allocator::plan(const vector<MemoryRequest> &requests)
+    {
+        IT_ASSERT(this->ptr == nullptr);
+        IT_ASSERT(used == 0, "Cannot plan on a used allocator");
+        vector<size_t> order(requests.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                         { return requests[a].size > requests[b].size; });
+
+        vector<size_t> offsets(requests.size());
+        vector<size_t> placed;
+        for (auto i : order)
+        {
+            size_t size = getAlignedSize(requests[i].size);
+            // placed buffers that are live together with this one
+            vector<pair<size_t, size_t>> busy;
+            for (auto j : placed)
+            {
+                if (requests[j].begin <= requests[i].end &&
+                    requests[i].begin <= requests[j].end)
+                    busy.emplace_back(offsets[j],
+                                      getAlignedSize(requests[j].size));
+            }
+            std::sort(busy.begin(), busy.end());
+            // the smallest gap between them that fits, or the end
+            size_t best = SIZE_MAX, bestGap = SIZE_MAX, cursor = 0;
+            for (auto &[offset, busySize] : busy)
+            {
+                if (offset > cursor && offset - cursor >= size &&
+                    offset - cursor < bestGap)
+                {
+                    best = cursor;
+                    bestGap = offset - cursor;
+                }
+                cursor = std::max(cursor, offset + busySize);
+            }
+            offsets[i] = best == SIZE_MAX ? cursor : best;
+            placed.emplace_back(i);
+            used = std::max(used, offsets[i] + size);
+        }
+        peak = used;
+        return offsets;
+    }
 
+    size_t Allocator::getLowerBound(const vector<MemoryRequest> &requests)
+    {
+        int lastStep = 0;
+        for (auto &request : requests)
+            lastStep = std::max(lastStep, request.end);
+        // difference array of the live bytes over the steps
+        vector<long long> delta(lastStep + 2, 0);
+        for (auto &request : requests)
+        {
+            delta[request.begin] += getAlignedSize(request.size);
+            delta[request.end + 1] -= getAlignedSize(request.size);
+        }
+        long long live = 0, maxLive = 0;
+        for (int step = 0; step <= lastStep; ++step)
+        {
+            live += delta[step];
+            maxLive = std::max(maxLive, live);
+        }
+        return maxLive;
     }
 
     void *Allocator::getPtr()
@@ -122,10 +245,22 @@ namespace infini
         if (this->ptr == nullptr)
         {
             this->ptr = runtime->alloc(this->peak);
-            printf("Allocator really alloc: %p %zu bytes\n", this->ptr, peak);
         }
         return this->ptr;
     }
+    void Allocator::reset()
+    {
+        if (this->ptr != nullptr)
+        {
+            runtime->dealloc(this->ptr);
+            this->ptr = nullptr;
+        }
+        used = 0;
+        peak = 0;
+        free_blocks.clear();
+        free_blocks_by_size.clear();
+    }
+
     //把任意大小“向上取整”到alignment的倍数
     size_t Allocator::getAlignedSize(size_t size)
     {
@@ -1,11 +1,15 @@
 #include "core/graph.h"
 #include "core/blob.h"
-#include "operators/transpose.h"
-#include "operators/matmul.h"
+#include "core/graph_rewrite.h"
+#include "core/kernel.h"
+#include "operators/concat.h"
+#include "operators/split.h"
+#include "utils/data_convert.h"
 #include <algorithm>
+#include <iterator>
 #include <numeric>
 #include <queue>
-#include <set>
+#include <unordered_set>
 
 namespace infini
 {
@@ -13,7 +17,26 @@ namespace infini
     void GraphObj::addOperatorAndConnect(const Operator &op)
     {
         sorted = false;
+        opIndex.emplace(op.get(), ops.size());
         ops.push_back(op);
+        touch(op);
+        connectInputs(op);
+        for (auto &output : op->getOutputs())
+        {
+            if (output)
+            {
+                output->setSource(op);
+                for (auto &succ : output->getTargets())
+                {
+                    succ->addPredecessors(op);
+                    op->addSuccessors(succ);
+                }
+            }
+        }
+    }
+
+    void GraphObj::connectInputs(const Operator &op)
+    {
         for (auto &input : op->getInputs())
         {
             if (input)
@@ -26,18 +49,64 @@ namespace infini
                 }
             }
         }
+    }
+
+    void GraphObj::disconnectInputs(const Operator &op)
+    {
+        for (auto &input : op->getInputs())
+        {
+            if (input)
+                input->removeTarget(op);
+        }
+        for (auto &pred : op->getPredecessors())
+            pred->removeSuccessors(op);
+        op->predecessors.clear();
+    }
+
+    void GraphObj::replaceInput(const Operator &op, const Tensor &from,
+                                const Tensor &to)
+    {
+        sorted = false;
+        disconnectInputs(op);
+        op->replaceInput(from, to);
+        connectInputs(op);
+        touch(op);
+        if (!from->getSource() && from->getTargets().empty())
+            removeTensor(from);
+    }
+
+    void GraphObj::replaceAllUses(const Tensor &from, const Tensor &to)
+    {
+        IT_ASSERT(from != to);
+        // replaceInput drops every occurrence of the op from the targets
+        for (auto targets = from->getTargets(); !targets.empty();
+             targets = from->getTargets())
+            replaceInput(targets.front(), from, to);
+    }
+
+    void GraphObj::eraseOperator(const Operator &op)
+    {
+        disconnectInputs(op);
         for (auto &output : op->getOutputs())
         {
-            if (output)
+            if (output && output->getSource() == op)
+                output->setSource(nullptr);
+        }
+        for (auto &succ : op->getSuccessors())
+            succ->removePredecessors(op);
+        op->successors.clear();
+        removeOperator(op);
+        TensorVec dangling;
+        for (auto &tensors : {op->getInputs(), op->getOutputs()})
+        {
+            for (auto &tensor : tensors)
             {
-                output->setSource(op);
-                for (auto &succ : output->getTargets())
-                {
-                    succ->addPredecessors(op);
-                    op->addSuccessors(succ);
-                }
+                if (tensor && !tensor->getSource() &&
+                    tensor->getTargets().empty())
+                    dangling.emplace_back(tensor);
             }
         }
+        removeTensors(dangling);
     }
 
     string GraphObj::toString() const
@@ -69,246 +138,383 @@ namespace infini
         {
             return true;
         }
-        std::vector<Operator> sorted;
-        std::unordered_set<OperatorObj *> flags;
-        sorted.reserve(ops.size());
-        flags.reserve(ops.size());
-        while (sorted.size() < ops.size())
+        // Kahn's algorithm. An op becomes ready once all producers of its
+        // inputs are placed. For the Original policy ready ops wait in a FIFO
+        // queue, O(V + E); the other policies keep them in a heap ordered by
+        // their key, then by their original position, O(V + E log V).
+        const size_t n = ops.size();
+        vector<vector<size_t>> succs(n);
+        vector<size_t> inDegree(n, 0);
+        for (size_t i = 0; i < n; ++i)
         {
-            // Any node is move to sorted in this loop.
-            auto modified = false;
-            for (auto const &op : ops)
+            for (auto &input : ops[i]->getInputs())
             {
-                if (auto const &inputs = op->getInputs();
-                    flags.find(op.get()) == flags.end() &&
-                    std::all_of(inputs.begin(), inputs.end(),
-                                [&flags](auto const &input)
-                                {
-                                    auto ptr = input->getSource().get();
-                                    return !ptr || flags.find(ptr) != flags.end();
-                                }))
-                {
-                    modified = true;
-                    sorted.emplace_back(op);
-                    flags.insert(op.get());
-                }
-            }
-            if (!modified)
-            {
-                return false;
+                auto source = input ? input->getSource() : nullptr;
+                if (!source)
+                    continue;
+                auto it = opIndex.find(source.get());
+                if (it == opIndex.end())
+                    continue;
+                succs[it->second].emplace_back(i);
+                ++inDegree[i];
             }
         }
-        this->ops = std::move(sorted);
-        return this->sorted = true;
-    }
 
-    void GraphObj::optimize()
-    {
-        // =================================== 作业 ===================================
-        // TODO: 设计一个算法来实现指定的图优化规则
-        // 图优化规则如下：
-        // 1. 去除冗余的算子（例如，两个相邻的算子都是 transpose 算子，且做的是相反的操作，可以将其全部删除）
-        // 2. 合并算子（例如，矩阵乘算子中含有属性transA、transB，如果其输入存在transpose，且对最后两个维度做交换，就可以将transpose融入到矩阵乘算子的属性中去）
-        // =================================== 作业 ===================================
-        
-        // ========== 策略说明 ==========
-        // 使用"标记-清除"策略：
-        // 1. 先遍历图，标记需要删除的算子和张量（不立即删除，避免迭代器失效）
-        // 2. 最后统一清理引用关系并删除
-        // ==============================
-        
-        std::set<Operator> opsToRemove;      // 标记要删除的算子
-        std::set<Tensor> tensorsToRemove;    // 标记要删除的张量
-        
-        // ==================== 优化1：去除相邻的可抵消的 Transpose ====================
-        // 原理：如果两个相邻的 Transpose 具有相同的 permute，例如：
-        //   Transpose({0,1,3,2}) → Transpose({0,1,3,2})
-        // 执行两次相同的转置操作等于恢复原状，可以直接消除这两个算子
-        // 
-        // 图变化示意：
-        //   优化前: i1 → [Transpose7] → t1 → [Transpose8] → t2 → [后续算子]
-        //   优化后: i1 ────────────────────────────────────────→ [后续算子]
-        // ===========================================================================
-        for (auto &op : ops)
+        // Places ops by decreasing `key(i)`, where keys are computed when an
+        // op becomes ready and recomputed by calling `update(i)`.
+        using Entry = pair<long long, size_t>;
+        auto cmp = [](const Entry &a, const Entry &b)
+        { return a.first != b.first ? a.first < b.first : a.second > b.second; };
+        std::priority_queue<Entry, vector<Entry>, decltype(cmp)> ready(cmp);
+        vector<size_t> order;
+        order.reserve(n);
+        vector<bool> placed(n, false);
+        auto kahn = [&](auto &&key, auto &&onPlace) -> bool
         {
-            // 跳过已标记删除的算子
-            if (opsToRemove.count(op)) continue;
-            // 只处理 Transpose 类型的算子
-            if (op->getOpType() != OpType::Transpose) continue;
-            
-            // 将算子转换为 TransposeObj 类型，获取更多信息
-            auto transposeOp = as<TransposeObj>(op);
-            // 获取当前 Transpose 的输入张量
-            Tensor inputTensor = transposeOp->getInputs(0);
-            // 获取产生这个输入张量的算子（即前一个算子）
-            Operator sourceOp = inputTensor->getSource();
-            
-            // 检查前一个算子是否存在且未被标记删除
-            if (!sourceOp || opsToRemove.count(sourceOp)) continue;
-            // 检查前一个算子是否也是 Transpose
-            if (sourceOp->getOpType() != OpType::Transpose) continue;
-            
-            // 获取前一个 Transpose 算子
-            auto prevTransposeOp = as<TransposeObj>(sourceOp);
-            // 获取两个 Transpose 的 permute 向量
-            auto perm1 = transposeOp->getPermute();      // 当前 Transpose 的 permute
-            auto perm2 = prevTransposeOp->getPermute();  // 前一个 Transpose 的 permute
-            
-            // 如果两个 permute 相同，说明可以抵消
-            // 例如：perm1 = perm2 = {0,1,3,2}，两次转置后恢复原状
-            if (perm1 == perm2)
+            auto degree = inDegree;
+            order.clear();
+            std::fill(placed.begin(), placed.end(), false);
+            for (size_t i = 0; i < n; ++i)
             {
-                // 获取相关的张量：
-                // originalTensor: 第一个 Transpose 的输入（最原始的张量）
-                // middleTensor: 两个 Transpose 之间的中间张量
-                // outputTensor: 第二个 Transpose 的输出
-                auto originalTensor = prevTransposeOp->getInputs(0);
-                auto middleTensor = inputTensor;
-                auto outputTensor = transposeOp->getOutput();
-                
-                // 重新连接：让使用 outputTensor 的后续算子改为使用 originalTensor
-                // 这样后续算子就直接使用原始输入，跳过了两个 Transpose
-                for (auto &succ : outputTensor->getTargets())
+                if (degree[i] == 0)
+                    ready.emplace(key(i), i);
+            }
+            while (!ready.empty())
+            {
+                auto [k, i] = ready.top();
+                ready.pop();
+                if (placed[i] || k != key(i)) // a stale entry
+                    continue;
+                placed[i] = true;
+                order.emplace_back(i);
+                onPlace(i);
+                for (auto succ : succs[i])
                 {
-                    succ->replaceInput(outputTensor, originalTensor);
+                    if (--degree[succ] == 0)
+                        ready.emplace(key(succ), succ);
                 }
-                
-                // 标记要删除的张量和算子
-                tensorsToRemove.insert(middleTensor);    // 删除中间张量
-                tensorsToRemove.insert(outputTensor);    // 删除输出张量
-                opsToRemove.insert(prevTransposeOp);     // 删除第一个 Transpose
-                opsToRemove.insert(transposeOp);         // 删除第二个 Transpose
             }
-        }
-        
-        // ==================== 优化2：将 Transpose 融合到 Matmul 中 ====================
-        // 原理：Matmul 算子有 transA 和 transB 属性，如果输入的 Transpose 只是
-        //      交换最后两个维度，可以直接设置 trans 属性，省去 Transpose 算子
-        // 
-        // 条件：Transpose 的 permute 必须是只交换最后两维
-        //   例如：4维张量的 permute = {0, 1, 3, 2}（前两维不变，后两维交换）
-        // 
-        // 图变化示意：
-        //   优化前: i2 → [Transpose9] → t3 → [Matmul(A, B)]
-        //   优化后: i2 ───────────────────→ [Matmul(A, B^T)]  (设置 transB=true)
-        // ===========================================================================
-        for (auto &op : ops)
+            return order.size() == n;
+        };
+        // `order` itself is the queue: ops are appended once ready.
+        auto kahnFifo = [&]() -> bool
         {
-            // 跳过已标记删除的算子
-            if (opsToRemove.count(op)) continue;
-            // 只处理 Transpose 类型的算子
-            if (op->getOpType() != OpType::Transpose) continue;
-            
-            auto transposeOp = as<TransposeObj>(op);
-            auto outputTensor = transposeOp->getOutput();  // Transpose 的输出张量
-            auto perm = transposeOp->getPermute();         // 获取 permute 向量
-            int rank = perm.size();                        // 张量的维度数
-            
-            // 至少需要2维才能交换最后两维
-            if (rank < 2) continue;
-            
-            // 检查 permute 是否只交换最后两维
-            // 条件：perm[rank-1] == rank-2 且 perm[rank-2] == rank-1
-            //       其他维度保持不变：perm[i] == i (对于 i < rank-2)
-            // 例如：{0, 1, 3, 2} 满足条件，{0, 2, 1, 3} 不满足
-            bool isLastTwoDimSwap = (perm[rank - 1] == rank - 2) && (perm[rank - 2] == rank - 1);
-            for (int i = 0; i < rank - 2; ++i)
+            auto degree = inDegree;
+            order.clear();
+            for (size_t i = 0; i < n; ++i)
             {
-                if (perm[i] != i) { isLastTwoDimSwap = false; break; }
+                if (degree[i] == 0)
+                    order.emplace_back(i);
             }
-            
-            // 如果不是只交换最后两维，跳过
-            if (!isLastTwoDimSwap) continue;
-            
-            // 查找使用这个 Transpose 输出的下游算子
-            for (auto &targetOp : outputTensor->getTargets())
+            for (size_t head = 0; head < order.size(); ++head)
             {
-                // 只处理 MatMul 类型的下游算子
-                if (targetOp->getOpType() != OpType::MatMul) continue;
-                
-                auto matmulOp = as<MatmulObj>(targetOp);
-                auto transposeInput = transposeOp->getInputs(0);  // Transpose 的原始输入
-                
-                // 判断 Transpose 的输出是 Matmul 的 A 输入还是 B 输入
-                if (matmulOp->getInputs(0) == outputTensor)
+                for (auto succ : succs[order[head]])
                 {
-                    // 是 A 输入：设置 transA 属性（取反，因为原来可能已经有值）
-                    matmulOp->setTransA(!matmulOp->getTransA());
-                    // 替换输入：Matmul 直接使用 Transpose 的原始输入
-                    matmulOp->replaceInput(outputTensor, transposeInput);
+                    if (--degree[succ] == 0)
+                        order.emplace_back(succ);
                 }
-                else if (matmulOp->getInputs(1) == outputTensor)
-                {
-                    // 是 B 输入：设置 transB 属性
-                    matmulOp->setTransB(!matmulOp->getTransB());
-                    matmulOp->replaceInput(outputTensor, transposeInput);
-                }
-                
-                // 标记要删除的张量和算子
-                tensorsToRemove.insert(outputTensor);
-                opsToRemove.insert(transposeOp);
-                break;  // 已处理，退出内层循环
             }
-        }
-        
-        // ==================== 清理引用关系 ==================== 
-        // 重要！删除算子前必须清理所有指向它的引用，否则会导致悬空指针崩溃
-        // 
-        // 图中的引用关系：
-        // - 张量的 targets 列表记录了使用该张量的算子
-        // - 张量的 source 记录了产生该张量的算子
-        // - 算子的 predecessors 记录了前驱算子
-        // - 算子的 successors 记录了后继算子
-        // 
-        // 如果不清理这些引用，后续打印图或遍历时会访问已删除的对象！
-        // =======================================================
-        for (auto &opToRemove : opsToRemove)
-        {
-            // 1. 从输入张量的 targets 列表中移除此算子
-            //    （告诉输入张量：我不再使用你了）
-            for (auto &input : opToRemove->getInputs())
+            return order.size() == n;
+        };
+        auto noOp = [](size_t) {};
+
+        bool ok = true;
+        switch (sortPolicy)
+        {
+        case TopoSortPolicy::Original:
+            ok = kahnFifo();
+            break;
+        case TopoSortPolicy::CriticalPath:
+        {
+            // The work left after an op is the largest sum of output sizes
+            // along a path from it, computed backwards over any valid order.
+            if (!(ok = kahnFifo()))
+                break;
+            vector<long long> work(n, 0);
+            for (auto it = order.rbegin(); it != order.rend(); ++it)
             {
-                if (input) input->removeTarget(opToRemove);
+                long long tail = 0;
+                for (auto succ : succs[*it])
+                    tail = std::max(tail, work[succ]);
+                long long self = 1;
+                for (auto &output : ops[*it]->getOutputs())
+                    self += output->size();
+                work[*it] = self + tail;
             }
-            
-            // 2. 从输出张量的 source 中移除此算子
-            //    （告诉输出张量：我不再是你的生产者了）
-            for (auto &output : opToRemove->getOutputs())
+            ok = kahn([&](size_t i) { return work[i]; }, noOp);
+            break;
+        }
+        case TopoSortPolicy::MemoryFirst:
+        {
+            // An op frees the inputs it is the last unplaced consumer of.
+            // pending[t] counts the unplaced ops reading tensor t; when it
+            // drops to 1 the key of the remaining consumer grows, so a fresh
+            // entry is pushed for it if it is ready.
+            std::unordered_map<TensorObj *, vector<size_t>> consumers;
+            for (size_t i = 0; i < n; ++i)
             {
-                if (output) output->setSource(nullptr);
+                for (auto &input : ops[i]->getInputs())
+                {
+                    if (!input)
+                        continue;
+                    auto &c = consumers[input.get()];
+                    if (c.empty() || c.back() != i)
+                        c.emplace_back(i);
+                }
             }
-            
-            // 3. 从前驱算子的 successors 列表中移除此算子
-            //    （告诉前驱：我不再是你的后继了）
-            for (auto &pred : opToRemove->getPredecessors())
+            std::unordered_map<TensorObj *, size_t> pending;
+            for (auto &[tensor, c] : consumers)
+                pending[tensor] = c.size();
+            auto freedBy = [&](const Tensor &input)
             {
-                pred->removeSuccessors(opToRemove);
-            }
-            
-            // 4. 从后继算子的 predecessors 列表中移除此算子
-            //    （告诉后继：我不再是你的前驱了）
-            for (auto &succ : opToRemove->getSuccessors())
+                // graph inputs, outputs and weights are never freed
+                return input->getSource() && !input->isWeight() &&
+                       pending.at(input.get()) == 1;
+            };
+            auto key = [&](size_t i)
             {
-                succ->removePredecessors(opToRemove);
-            }
+                long long delta = 0;
+                const auto &inputs = ops[i]->getInputs();
+                for (size_t k = 0; k < inputs.size(); ++k)
+                {
+                    if (inputs[k] &&
+                        std::find(inputs.begin(), inputs.begin() + k,
+                                  inputs[k]) == inputs.begin() + k &&
+                        freedBy(inputs[k]))
+                        delta += inputs[k]->getBytes();
+                }
+                for (auto &output : ops[i]->getOutputs())
+                    delta -= output->getBytes();
+                return delta;
+            };
+            vector<size_t> degree = inDegree;
+            auto onPlace = [&](size_t i)
+            {
+                for (auto succ : succs[i])
+                    --degree[succ];
+                const auto &inputs = ops[i]->getInputs();
+                for (size_t k = 0; k < inputs.size(); ++k)
+                {
+                    if (!inputs[k] ||
+                        std::find(inputs.begin(), inputs.begin() + k,
+                                  inputs[k]) != inputs.begin() + k)
+                        continue;
+                    auto &count = pending.at(inputs[k].get());
+                    if (--count != 1)
+                        continue;
+                    for (auto c : consumers.at(inputs[k].get()))
+                    {
+                        if (!placed[c] && degree[c] == 0)
+                            ready.emplace(key(c), c);
+                    }
+                }
+            };
+            ok = kahn(key, onPlace);
+            break;
         }
-        
-        // ==================== 批量删除 ====================
-        // 从图的 tensors 和 ops 列表中移除被标记的对象
-        for (auto &t : tensorsToRemove) removeTensor(t);
-        for (auto &o : opsToRemove) removeOperator(o);
+        default:
+            IT_TODO_HALT();
+        }
+        if (!ok)
+        {
+            return false;
+        }
+        OpVec sortedOps;
+        sortedOps.reserve(n);
+        for (auto i : order)
+            sortedOps.emplace_back(std::move(ops[i]));
+        this->ops = std::move(sortedOps);
+        reindexOperators();
+        return this->sorted = true;
+    }
+
+    vector<RewriteStats> GraphObj::optimize()
+    {
+        // 先合并重复的算子，再应用图优化规则。规则以声明式的 RewriteRule
+        // 写在 rewrite_rules.cc 中，按阶段依次应用，每个阶段都运行到不动点。
+        freezeWeightOrder();
+        RewriteStats cse{"CommonSubexpressionElimination"};
+        cse.hits = cse.matches = eliminateCommonSubexpressions(*this);
+        vector<RewriteStats> stats{cse};
+        for (auto &rules : getOptimizePhases())
+        {
+            RewriteEngine engine(std::move(rules));
+            engine.run(*this);
+            auto &phase = engine.getStats();
+            stats.insert(stats.end(), phase.begin(), phase.end());
+        }
+        RewriteStats batch{"BatchIndependentMatmuls"};
+        batch.hits = batch.matches = batchIndependentMatmuls(*this);
+        stats.emplace_back(batch);
+        // rewrites erase the constants they replace, e.g. a divisor
+        releaseDeadConstants();
+        return stats;
+    }
+
+    OpVec GraphObj::getProducers(const TensorVec &outputs)
+    {
+        IT_ASSERT(topo_sort() == true);
+        // Mark backwards from the outputs, then keep the graph order.
+        std::unordered_set<OperatorObj *> needed;
+        OpVec stack;
+        auto visit = [&](const Tensor &tensor)
+        {
+            auto source = tensor ? tensor->getSource() : nullptr;
+            if (source && needed.insert(source.get()).second)
+                stack.emplace_back(source);
+        };
+        for (auto &output : outputs)
+        {
+            IT_ASSERT(hasTensor(output));
+            visit(output);
+        }
+        while (!stack.empty())
+        {
+            auto op = std::move(stack.back());
+            stack.pop_back();
+            for (auto &input : op->getInputs())
+                visit(input);
+        }
+        OpVec producers;
+        for (auto &op : ops)
+        {
+            if (needed.count(op.get()))
+                producers.emplace_back(op);
+        }
+        return producers;
+    }
+
+    size_t GraphObj::eliminateDeadCode(const TensorVec &outputs)
+    {
+        auto live = getProducers(outputs);
+        if (live.size() == ops.size())
+            return 0;
+        std::unordered_set<OperatorObj *> needed;
+        for (auto &op : live)
+            needed.insert(op.get());
+        OpVec dead;
+        for (auto &op : ops)
+        {
+            if (!needed.count(op.get()))
+                dead.emplace_back(op);
+        }
+        for (auto &op : dead)
+            eraseOperator(op);
+        return dead.size();
+    }
+
+    void GraphObj::removeOperators(const OpVec &toRemove)
+    {
+        size_t first = ops.size();
+        for (auto &op : toRemove)
+        {
+            auto it = opIndex.find(op.get());
+            if (it == opIndex.end())
+                continue;
+            first = std::min(first, it->second);
+            ops[it->second] = nullptr;
+            opIndex.erase(it);
+            touch(op);
+        }
+        if (first == ops.size())
+            return;
+        ops.erase(std::remove(ops.begin() + first, ops.end(), nullptr),
+                  ops.end());
+        reindexOperators(first);
+    }
+
+    void GraphObj::removeTensors(const TensorVec &toRemove)
+    {
+        size_t first = tensors.size();
+        for (auto &tensor : toRemove)
+        {
+            auto it = tensorIndex.find(tensor->getFuid());
+            if (it == tensorIndex.end() || tensors[it->second] != tensor)
+                continue;
+            first = std::min(first, it->second);
+            tensors[it->second] = nullptr;
+            tensorIndex.erase(it);
+            touch(tensor);
+        }
+        if (first == tensors.size())
+            return;
+        tensors.erase(
+            std::remove(tensors.begin() + first, tensors.end(), nullptr),
+            tensors.end());
+        reindexTensors(first);
+    }
+
+    void GraphObj::reindexOperators(size_t from)
+    {
+        for (size_t i = from; i < ops.size(); ++i)
+            opIndex[ops[i].get()] = i;
+    }
+
+    void GraphObj::reindexTensors(size_t from)
+    {
+        for (size_t i = from; i < tensors.size(); ++i)
+            tensorIndex[tensors[i]->getFuid()] = i;
+    }
+
+    bool GraphObj::hasTensor(const Tensor &tensor) const
+    {
+        auto it = tensorIndex.find(tensor->getFuid());
+        return it != tensorIndex.end() && tensors[it->second] == tensor;
+    }
+
+    void GraphObj::touch(const Operator &op)
+    {
+        // The neighbours are checked too, as they may still point to a
+        // removed operator.
+        if (dirtyAll)
+            return;
+        if (dirtyOps.size() > 4 * ops.size() + 64)
+        {
+            // stop tracking instead of keeping removed nodes alive
+            dirtyAll = true;
+            dirtyOps.clear();
+            dirtyTensors.clear();
+            return;
+        }
+        dirtyOps.emplace_back(op);
+        for (auto &tensor : op->getInputs())
+            if (tensor)
+                dirtyTensors.emplace_back(tensor);
+        for (auto &tensor : op->getOutputs())
+            if (tensor)
+                dirtyTensors.emplace_back(tensor);
+        for (auto &pred : op->getPredecessors())
+            dirtyOps.emplace_back(pred);
+        for (auto &succ : op->getSuccessors())
+            dirtyOps.emplace_back(succ);
+    }
+
+    void GraphObj::touch(const Tensor &tensor)
+    {
+        if (dirtyAll)
+            return;
+        if (dirtyTensors.size() > 4 * tensors.size() + 64)
+        {
+            dirtyAll = true;
+            dirtyOps.clear();
+            dirtyTensors.clear();
+            return;
+        }
+        dirtyTensors.emplace_back(tensor);
+        if (auto source = tensor->getSource())
+            dirtyOps.emplace_back(source);
+        for (auto &target : tensor->getTargets())
+            dirtyOps.emplace_back(target);
     }
 
     Tensor GraphObj::getTensor(int fuid) const
     {
-        for (auto tensor : tensors)
+        auto it = tensorIndex.find(fuid);
+        if (it == tensorIndex.end())
         {
-            if (tensor->getFuid() == fuid)
-            {
-                return tensor;
-            }
+            return nullptr;
         }
-        return nullptr;
+        return tensors[it->second];
     }
 
     void GraphObj::shape_infer()
@@ -334,66 +540,397 @@ namespace infini
         }
     }
 
-    void GraphObj::dataMalloc()
+    GraphObj::~GraphObj()
+    {
+        for (auto &[tensor, ptr] : foldedConstants)
+            runtime->dealloc(ptr);
+    }
+
+    Tensor GraphObj::addConstant(Shape dim, DataType dtype)
+    {
+        auto tensor = addTensor(std::move(dim), dtype);
+        bindConstant(tensor);
+        return tensor;
+    }
+
+    void GraphObj::bindConstant(const Tensor &tensor)
+    {
+        void *ptr = runtime->alloc(tensor->getBytes());
+        foldedConstants.emplace_back(tensor, ptr);
+        tensor->setDataBlob(make_ref<BlobObj>(runtime, ptr));
+        tensor->setWeight();
+    }
+
+    size_t GraphObj::foldConstants()
+    {
+        IT_ASSERT(topo_sort() == true);
+        freezeWeightOrder();
+        const auto &registry = KernelRegistry::getInstance();
+        OpVec folded;
+        // In topological order, so chains of constant ops fold in one pass.
+        for (auto &op : ops)
+        {
+            const auto &inputs = op->getInputs();
+            bool constant = !inputs.empty();
+            // kernels only convert between the types is_convertible allows,
+            // e.g. Cast stops on Float16, which must wait for run time
+            for (auto &input : inputs)
+                constant = constant && input->isWeight() && input->hasData() &&
+                           is_convertible(input->getDType());
+            // a graph output would lose its producer
+            for (auto &output : op->getOutputs())
+                constant = constant && !output->getTargets().empty() &&
+                           is_convertible(output->getDType());
+            auto attrs = KernelAttrs{runtime->getDevice(),
+                                     op->getOpType().underlying()};
+            if (!constant || !registry.hasKernel(attrs))
+                continue;
+            for (auto &output : op->getOutputs())
+                bindConstant(output);
+            registry.getKernel(attrs)->compute(op, runtime.get());
+            folded.emplace_back(op);
+        }
+        for (auto &op : folded)
+            eraseOperator(op);
+        // intermediates read only by folded ops have left the graph
+        releaseDeadConstants();
+        return folded.size();
+    }
+
+    void GraphObj::releaseDeadConstants()
+    {
+        auto dead = std::partition(foldedConstants.begin(), foldedConstants.end(),
+                                   [&](const pair<Tensor, void *> &constant)
+                                   { return hasTensor(constant.first); });
+        for (auto it = dead; it != foldedConstants.end(); ++it)
+            runtime->dealloc(it->second);
+        foldedConstants.erase(dead, foldedConstants.end());
+
+        // Weights rebound by loadWeights do not use the pool anymore either.
+        if (pooledWeights.empty())
+            return;
+        auto base = static_cast<char *>(weightAllocator.getPtr());
+        auto inPool = [&](const Tensor &tensor)
+        {
+            auto ptr = tensor->getRawDataPtr<char *>();
+            return hasTensor(tensor) && base <= ptr &&
+                   ptr < base + weightAllocator.getPeak();
+        };
+        TensorVec live;
+        std::copy_if(pooledWeights.begin(), pooledWeights.end(),
+                     std::back_inserter(live), inPool);
+        if (live.size() == pooledWeights.size())
+            return;
+        vector<vector<char>> data;
+        for (auto &tensor : live)
+        {
+            auto ptr = tensor->getRawDataPtr<char *>();
+            data.emplace_back(ptr, ptr + tensor->getBytes());
+        }
+        weightAllocator.reset();
+        vector<size_t> offsets;
+        for (auto &tensor : live)
+            offsets.emplace_back(weightAllocator.alloc(tensor->getBytes()));
+        base = live.empty() ? nullptr
+                            : static_cast<char *>(weightAllocator.getPtr());
+        for (size_t i = 0; i < live.size(); ++i)
+        {
+            std::memcpy(base + offsets[i], data[i].data(), data[i].size());
+            live[i]->setDataBlob(make_ref<BlobObj>(runtime, base + offsets[i]));
+        }
+        pooledWeights = std::move(live);
+    }
+
+    void GraphObj::freezeWeightOrder()
+    {
+        if (weightOrder)
+            return;
+        weightOrder.emplace();
+        for (auto &tensor : tensors)
+        {
+            if (tensor->isWeight())
+                weightOrder->emplace_back(tensor->getFuid());
+        }
+    }
+
+    TensorVec GraphObj::getNumberedWeights() const
+    {
+        TensorVec weights;
+        if (!weightOrder)
+        {
+            std::copy_if(tensors.begin(), tensors.end(),
+                         std::back_inserter(weights),
+                         [](const Tensor &tensor) { return tensor->isWeight(); });
+            return weights;
+        }
+        for (auto fuid : *weightOrder)
+            weights.emplace_back(getTensor(fuid));
+        return weights;
+    }
+
+    size_t GraphObj::loadWeights(const string &path)
+    {
+        auto file = make_ref<WeightFileObj>(path);
+        auto weights = getNumberedWeights();
+        IT_ASSERT(file->getSlots() == weights.size(),
+                  "The weight file " + path + " is for a model with " +
+                      std::to_string(file->getSlots()) +
+                      " weights, the graph has " +
+                      std::to_string(weights.size()));
+        size_t count = 0;
+        for (size_t i = 0; i < weights.size(); ++i)
+        {
+            if (!weights[i])
+                continue;
+            void *ptr = file->getData(i, weights[i]);
+            IT_ASSERT(ptr != nullptr, "Weight " + std::to_string(i) +
+                                          " is missing from " + path);
+            weights[i]->setDataBlob(make_ref<BlobObj>(runtime, ptr));
+            ++count;
+        }
+        weightFiles.emplace_back(file);
+        return count;
+    }
+
+    void GraphObj::saveWeights(const string &path) const
+    {
+        WeightFileObj::save(path, getNumberedWeights());
+    }
+
+    void GraphObj::weightMalloc()
+    {
+        TensorVec pending;
+        for (auto &tensor : tensors)
+        {
+            if (tensor->isWeight() && !tensor->hasData())
+                pending.emplace_back(tensor);
+        }
+        if (pending.empty())
+            return;
+        IT_ASSERT(weightAllocator.getPeak() == 0,
+                  "The weight pool is allocated, cannot add weights to it");
+        vector<size_t> offsets;
+        for (auto &tensor : pending)
+            offsets.emplace_back(weightAllocator.alloc(tensor->getBytes()));
+        void *basePtr = weightAllocator.getPtr();
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            void *ptr = static_cast<char *>(basePtr) + offsets[i];
+            pending[i]->setDataBlob(make_ref<BlobObj>(runtime, ptr));
+        }
+        pooledWeights = std::move(pending);
+    }
+
+    void GraphObj::dataMalloc(MemoryStrategy strategy)
     {
-        // ==================== 内存分配流程 ====================
-        // 1. 首先进行拓扑排序，确保算子按正确的执行顺序排列
-        // 2. 为每个张量分配内存空间（通过 allocator）
-        // 3. 将实际的内存指针绑定到张量
-        // 
-        // 内存管理架构：
-        //   allocator 管理一块连续的内存池
-        //   每个张量获得一个偏移量（offset），表示它在内存池中的位置
-        //   实际地址 = 内存池基地址 + 偏移量
-        // ======================================================
-        
         // 拓扑排序，确保算子按依赖关系排序
         IT_ASSERT(topo_sort() == true);
 
-        // =================================== 作业 ===================================
-        // TODO：利用 allocator 给计算图分配内存
-        // HINT: 获取分配好的内存指针后，可以调用 tensor 的 setDataBlob 函数给 tensor 绑定内存
-        // =================================== 作业 ===================================
-        
-        // ========== 第一步：为每个张量分配空间 ==========
-        // allocator.alloc(size) 会返回一个偏移量（offset）
-        // 这个偏移量是相对于内存池起始地址的位置
-        // 需要先记录所有偏移量，因为 getPtr() 必须在所有 alloc 之后调用
-        std::vector<size_t> offsets;
+        // ========== 第零步：为权重分配持久内存，并释放上一次的激活内存 ==========
+        weightMalloc();
+        allocator.reset();
+
+        // ========== 第一步：计算每个张量的生命周期 ==========
+        // Step i executes ops[i]. A tensor is born at the step of its producer
+        // and dies after the step of its last consumer, so an op never writes
+        // into the buffer of one of its own inputs. Graph inputs are written
+        // by the user before run() and graph outputs are read after it, so
+        // both stay alive for the whole execution.
+        int lastStep = std::max((int)ops.size() - 1, 0);
+        std::unordered_map<TensorObj *, size_t> position;
+        for (size_t i = 0; i < tensors.size(); ++i)
+            position[tensors[i].get()] = i;
+        vector<MemoryRequest> requests(tensors.size());
+        for (size_t i = 0; i < tensors.size(); ++i)
+            requests[i] = {tensors[i]->getBytes(), 0, 0};
+        for (int step = 0; step < (int)ops.size(); ++step)
+        {
+            for (auto &input : ops[step]->getInputs())
+                requests[position.at(input.get())].end = step;
+            for (auto &output : ops[step]->getOutputs())
+                requests[position.at(output.get())].begin = step;
+        }
+        for (size_t i = 0; i < tensors.size(); ++i)
+        {
+            if (!tensors[i]->getSource() || tensors[i]->getTargets().empty())
+                requests[i].end = lastStep;
+        }
+
+        // ========== 第二步：让输出复用即将释放的输入 ==========
+        // Tensors sharing a buffer form a group owned by one tensor: owner[i]
+        // is the owner of tensor i and innerOffset[i] the position of tensor i
+        // inside the owner's buffer. The request of an owner covers the
+        // lifetimes of the whole group.
+        vector<size_t> owner(tensors.size()), innerOffset(tensors.size(), 0);
+        vector<size_t> groupSize(tensors.size(), 1);
+        std::iota(owner.begin(), owner.end(), 0);
+        const auto &kernelRegistry = KernelRegistry::getInstance();
+        for (int step = 0; step < (int)ops.size(); ++step)
+        {
+            auto &op = ops[step];
+            if (op->getOpType() == OpType::Concat)
+            {
+                // When the dims before the concat axis are all 1, every input
+                // is one contiguous block of the output, so its producer can
+                // write there directly and the Concat kernel has nothing to
+                // copy, unless it converts a folded Cast. Only inputs that own
+                // a buffer of their own and are produced by the graph are
+                // moved.
+                auto concat = as<ConcatObj>(op);
+                auto output = position.at(op->getOutput().get());
+                auto outDims = op->getOutput()->getDims();
+                if (std::accumulate(outDims.begin(),
+                                    outDims.begin() + concat->getDim(), 1,
+                                    std::multiplies{}) != 1 ||
+                    !(op->getDType() == op->getOutDType()))
+                    continue;
+                const auto &inputs = op->getInputs();
+                size_t offset = 0;
+                for (size_t k = 0; k < inputs.size(); ++k)
+                {
+                    auto input = position.at(inputs[k].get());
+                    bool repeated = std::count(inputs.begin(), inputs.end(),
+                                               inputs[k]) > 1;
+                    if (!repeated && inputs[k]->getSource() &&
+                        !inputs[k]->isWeight() && owner[input] == input &&
+                        groupSize[input] == 1)
+                    {
+                        owner[input] = output;
+                        innerOffset[input] = offset;
+                        groupSize[output] += 1;
+                        requests[output].begin = std::min(
+                            requests[output].begin, requests[input].begin);
+                        requests[output].end =
+                            std::max(requests[output].end, requests[input].end);
+                    }
+                    offset += inputs[k]->getBytes();
+                }
+                continue;
+            }
+            if (op->getOpType() == OpType::Split)
+            {
+                // The mirror of Concat: when the dims before the split axis
+                // are all 1, every output is one contiguous block of the
+                // input and is placed there, so the Split kernel has nothing
+                // to copy. Weights do not live in the arena.
+                auto split = as<SplitObj>(op);
+                auto input = position.at(op->getInputs(0).get());
+                auto group = owner[input];
+                auto inDims = op->getInputs(0)->getDims();
+                if (std::accumulate(inDims.begin(),
+                                    inDims.begin() + split->getDim(), 1,
+                                    std::multiplies{}) != 1 ||
+                    tensors[group]->isWeight())
+                    continue;
+                size_t offset = innerOffset[input];
+                for (auto &tensor : op->getOutputs())
+                {
+                    auto output = position.at(tensor.get());
+                    if (owner[output] == output && groupSize[output] == 1)
+                    {
+                        owner[output] = group;
+                        innerOffset[output] = offset;
+                        groupSize[group] += 1;
+                        requests[group].end =
+                            std::max(requests[group].end, requests[output].end);
+                    }
+                    offset += tensor->getBytes();
+                }
+                continue;
+            }
+            auto kernelAttrs =
+                KernelAttrs{runtime->getDevice(), op->getOpType().underlying()};
+            if (op->getOutputs().size() != 1 ||
+                !kernelRegistry.hasKernel(kernelAttrs))
+                continue;
+            auto *kernel = kernelRegistry.getKernel(kernelAttrs);
+            auto output = position.at(op->getOutput().get());
+            const auto &inputs = op->getInputs();
+            for (size_t k = 0; k < inputs.size(); ++k)
+            {
+                auto input = position.at(inputs[k].get());
+                auto group = owner[input];
+                // the buffer must die at this op and not belong to the user
+                if (!tensors[group]->getSource() ||
+                    tensors[group]->isWeight() || requests[group].end != step)
+                    continue;
+                if (inputs[k]->getDims() != tensors[output]->getDims() ||
+                    !(inputs[k]->getDType() == tensors[output]->getDType()))
+                    continue;
+                // other inputs must not be read from the same buffer
+                if (std::any_of(inputs.begin(), inputs.end(), [&](auto &other)
+                                { return other != inputs[k] &&
+                                         owner[position.at(other.get())] ==
+                                             group; }))
+                    continue;
+                if (!kernel->supportsInPlace(op, k))
+                    continue;
+                owner[output] = group;
+                innerOffset[output] = innerOffset[input];
+                groupSize[group] += 1;
+                requests[group].end =
+                    std::max(requests[group].end, requests[output].end);
+                break;
+            }
+        }
+        vector<size_t> groups;
+        vector<MemoryRequest> groupRequests;
+        for (size_t i = 0; i < tensors.size(); ++i)
+        {
+            if (owner[i] == i && !tensors[i]->isWeight())
+            {
+                groups.emplace_back(i);
+                groupRequests.emplace_back(requests[i]);
+            }
+        }
+
+        // ========== 第三步：为每个缓冲区分配偏移量 ==========
+        memoryStats = MemoryStats();
+        memoryStats.weightBytes = weightAllocator.getPeak();
+        for (auto &[tensor, ptr] : foldedConstants)
+            memoryStats.constantBytes += tensor->getBytes();
         for (auto &tensor : tensors)
         {
-            // 获取张量需要的字节数（元素数量 × 数据类型大小）
-            size_t size = tensor->getBytes();
-            // 调用 allocator 分配内存，返回偏移量
-            // 注意：alloc 只是"登记"需要的空间，记录偏移量，不实际分配内存
-            size_t offset = allocator.alloc(size);
-            offsets.push_back(offset);
-        }
-        
-        // ========== 第二步：获取实际的内存基地址 ==========
-        // getPtr() 会根据之前 alloc 记录的 peak 值，向 runtime 申请实际的内存
-        // 返回的 basePtr 是整个内存池的起始地址
+            if (!tensor->isWeight())
+                memoryStats.tensorBytes += tensor->getBytes();
+        }
+        memoryStats.lowerBoundBytes = allocator.getLowerBound(groupRequests);
+        vector<size_t> groupOffsets;
+        if (strategy == MemoryStrategy::Offline)
+        {
+            groupOffsets = allocator.plan(groupRequests);
+            Allocator online(runtime);
+            online.replay(groupRequests);
+            memoryStats.onlineBytes = online.getPeak();
+        }
+        else
+        {
+            groupOffsets = allocator.replay(groupRequests);
+            memoryStats.onlineBytes = allocator.getPeak();
+        }
+        memoryStats.arenaBytes = allocator.getPeak();
+        vector<size_t> offsets(tensors.size());
+        for (size_t g = 0; g < groups.size(); ++g)
+            offsets[groups[g]] = groupOffsets[g];
+
+        // ========== 第四步：获取实际的内存基地址并绑定到张量 ==========
         void *basePtr = allocator.getPtr();
-        
-        // ========== 第三步：为每个张量设置数据指针 ==========
         for (size_t i = 0; i < tensors.size(); ++i)
         {
-            // 计算实际地址：内存池基地址 + 该张量的偏移量
-            // 注意：必须将 basePtr 转为 char* 才能进行字节级别的指针运算
-            void *ptr = static_cast<char*>(basePtr) + offsets[i];
-            
-            // 创建 BlobObj 对象并绑定到张量
-            // BlobObj 是一个包装类，持有指针和 runtime 信息
+            if (tensors[i]->isWeight())
+                continue;
+            void *ptr = static_cast<char *>(basePtr) + offsets[owner[i]] +
+                        innerOffset[i];
             tensors[i]->setDataBlob(make_ref<BlobObj>(runtime, ptr));
         }
-        
-        // 打印内存分配信息（用于调试）
-        allocator.info();
     }
 
     Tensor GraphObj::addTensor(Shape dim, DataType dtype)
     {
-        return tensors.emplace_back(make_ref<TensorObj>(dim, dtype, runtime));
+        auto tensor = make_ref<TensorObj>(dim, dtype, runtime);
+        tensorIndex.emplace(tensor->getFuid(), tensors.size());
+        touch(tensor);
+        return tensors.emplace_back(tensor);
     }
 
     Tensor GraphObj::addTensor(const Tensor &tensor)
@@ -402,7 +939,9 @@ namespace infini
                   std::string("Tensor runtime mismatch: cannot add a tenosr in ") +
                       tensor->getRuntime()->toString() + " to " +
                       runtime->toString());
+        tensorIndex.emplace(tensor->getFuid(), tensors.size());
         tensors.emplace_back(tensor);
+        touch(tensor);
         return tensor;
     }
 
@@ -417,48 +956,69 @@ namespace infini
     // tensor has no "source" and no "target" must not exist.
     // "inputs" or "outputs" of operators must be in "tensors"
     // "predecessors" and "successors" of an operator of "ops" must be in "ops".
-    bool GraphObj::checkValid() const
+    // two tensors with the same FUID must not exist.
+    bool GraphObj::checkValid(bool incremental) const
     {
-        for (auto tensor : tensors)
+        // Membership goes through opIndex and tensorIndex, so each rule is
+        // O(1). Uniqueness of FUIDs holds if every tensor is the one its FUID
+        // indexes and the index has no other entry.
+        auto checkTensor = [&](const Tensor &tensor)
         {
+            IT_ASSERT(hasTensor(tensor), std::to_string(tensor->getFuid()));
             IT_ASSERT(!(tensor->getTargets().size() == 0 &&
                         nullptr == tensor->getSource()));
             for (auto op : tensor->getTargets())
             {
-                IT_ASSERT(std::find(ops.begin(), ops.end(), op) != ops.end());
+                IT_ASSERT(hasOperator(op));
             }
             auto op = tensor->getSource();
-            IT_ASSERT(!(op && std::find(ops.begin(), ops.end(), op) == ops.end()));
-        }
-        for (auto op : ops)
+            IT_ASSERT(!(op && !hasOperator(op)));
+        };
+        auto checkOperator = [&](const Operator &op)
         {
             for (auto tensor : op->getInputs())
             {
-                IT_ASSERT(std::find(tensors.begin(), tensors.end(), tensor) !=
-                          tensors.end());
+                IT_ASSERT(tensor && hasTensor(tensor));
             }
             for (auto tensor : op->getOutputs())
             {
-                IT_ASSERT(std::find(tensors.begin(), tensors.end(), tensor) !=
-                          tensors.end());
+                IT_ASSERT(tensor && hasTensor(tensor));
             }
             for (auto pre : op->getPredecessors())
             {
-                IT_ASSERT(std::find(ops.begin(), ops.end(), pre) != ops.end());
+                IT_ASSERT(hasOperator(pre));
             }
             for (auto suc : op->getSuccessors())
             {
-                IT_ASSERT(std::find(ops.begin(), ops.end(), suc) != ops.end());
+                IT_ASSERT(hasOperator(suc));
+            }
+        };
+        if (incremental && !dirtyAll)
+        {
+            // removed nodes are skipped, their neighbours are dirty as well
+            for (auto &tensor : dirtyTensors)
+            {
+                if (hasTensor(tensor))
+                    checkTensor(tensor);
+            }
+            for (auto &op : dirtyOps)
+            {
+                if (hasOperator(op))
+                    checkOperator(op);
             }
         }
-        std::set<UidBaseType> s;
-        // check whether two tensors with the same FUID exist
-        for (auto tensor : tensors)
+        else
         {
-            int cnt = s.count(tensor->getFuid());
-            IT_ASSERT(cnt == 0, std::to_string(tensor->getFuid()));
-            s.insert(tensor->getFuid());
+            IT_ASSERT(opIndex.size() == ops.size());
+            IT_ASSERT(tensorIndex.size() == tensors.size());
+            for (auto &tensor : tensors)
+                checkTensor(tensor);
+            for (auto &op : ops)
+                checkOperator(op);
         }
+        dirtyOps.clear();
+        dirtyTensors.clear();
+        dirtyAll = false;
         return true;
     }
 
@@ -0,0 +1,278 @@
+#include "core/graph_rewrite.h"
+#include <chrono>
+#include <deque>
+#include <unordered_set>
+
+namespace infini
+{
+
+    Pattern &Pattern::where(Predicate pred)
+    {
+        predicates.emplace_back(std::move(pred));
+        return *this;
+    }
+
+    Pattern &Pattern::input(size_t index, Pattern producer)
+    {
+        inputs.emplace_back(index, std::move(producer));
+        return *this;
+    }
+
+    Pattern &Pattern::singleUse()
+    {
+        single = true;
+        return *this;
+    }
+
+    bool Pattern::match(const Operator &op, OpVec &matched) const
+    {
+        if (type && op->getOpType() != *type)
+            return false;
+        if (single)
+        {
+            for (auto &output : op->getOutputs())
+            {
+                auto targets = output->getTargets();
+                for (auto &target : targets)
+                {
+                    if (target != targets.front())
+                        return false;
+                }
+                if (targets.empty())
+                    return false; // a graph output
+            }
+        }
+        size_t mark = matched.size();
+        matched.emplace_back(op);
+        for (auto &[index, producer] : inputs)
+        {
+            Tensor input = index < op->getInputs().size()
+                               ? op->getInputs(index)
+                               : nullptr;
+            Operator source = input ? input->getSource() : nullptr;
+            if (!source || !producer.match(source, matched))
+            {
+                matched.resize(mark);
+                return false;
+            }
+        }
+        for (auto &pred : predicates)
+        {
+            if (!pred(op))
+            {
+                matched.resize(mark);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    RewriteEngine::RewriteEngine(vector<RewriteRule> rules)
+    {
+        for (auto &rule : rules)
+            addRule(std::move(rule));
+    }
+
+    RewriteEngine &RewriteEngine::addRule(RewriteRule rule)
+    {
+        size_t id = rules.size();
+        if (auto type = rule.pattern.getRootType())
+            rulesByType[type->underlying()].emplace_back(id);
+        else
+            anyTypeRules.emplace_back(id);
+        stats.push_back({rule.name});
+        rules.emplace_back(std::move(rule));
+        return *this;
+    }
+
+    bool RewriteEngine::tryRules(GraphObj &graph, const Operator &op,
+                                 OpVec &touched)
+    {
+        auto tryRule = [&](size_t id)
+        {
+            auto begin = std::chrono::steady_clock::now();
+            OpVec matched;
+            bool hit = false;
+            if (rules[id].pattern.match(op, matched))
+            {
+                ++stats[id].matches;
+                // The ops next to the matched subgraph are the ones a new
+                // match may appear at, collect them through the tensors
+                // since the rewrite may replace every matched op.
+                TensorVec around;
+                for (auto &m : matched)
+                {
+                    for (auto &t : m->getInputs())
+                        around.emplace_back(t);
+                    for (auto &t : m->getOutputs())
+                        around.emplace_back(t);
+                }
+                hit = rules[id].rewrite(graph, matched);
+                if (hit)
+                {
+                    ++stats[id].hits;
+                    for (auto &t : around)
+                    {
+                        if (!t)
+                            continue;
+                        if (auto source = t->getSource())
+                            touched.emplace_back(source);
+                        for (auto &target : t->getTargets())
+                            touched.emplace_back(target);
+                    }
+                }
+            }
+            auto end = std::chrono::steady_clock::now();
+            stats[id].ms +=
+                std::chrono::duration<double, std::milli>(end - begin).count();
+            return hit;
+        };
+        auto it = rulesByType.find(op->getOpType().underlying());
+        if (it != rulesByType.end())
+        {
+            for (auto id : it->second)
+            {
+                if (tryRule(id))
+                    return true;
+            }
+        }
+        for (auto id : anyTypeRules)
+        {
+            if (tryRule(id))
+                return true;
+        }
+        return false;
+    }
+
+    size_t RewriteEngine::run(GraphObj &graph)
+    {
+        size_t total = 0;
+        std::deque<Operator> worklist;
+        std::unordered_set<OperatorObj *> queued;
+        auto push = [&](const Operator &op)
+        {
+            if (queued.insert(op.get()).second)
+                worklist.emplace_back(op);
+        };
+        IT_ASSERT(graph.topo_sort());
+        for (auto &op : graph.getOperators())
+            push(op);
+        auto apply = [&](const Operator &op)
+        {
+            OpVec touched;
+            if (!tryRules(graph, op, touched))
+                return false;
+            ++total;
+            for (auto &t : touched)
+            {
+                if (graph.hasOperator(t))
+                    push(t);
+            }
+            return true;
+        };
+        bool changed = true;
+        while (changed)
+        {
+            while (!worklist.empty())
+            {
+                Operator op = std::move(worklist.front());
+                worklist.pop_front();
+                queued.erase(op.get());
+                if (graph.hasOperator(op)) // not erased by an earlier rewrite
+                    apply(op);
+            }
+            // The final sweep: the worklist only covers the neighbourhood
+            // of each rewrite, so look at every op once more.
+            changed = false;
+            OpVec ops = graph.getOperators();
+            for (auto &op : ops)
+            {
+                if (graph.hasOperator(op) && apply(op))
+                    changed = true;
+            }
+        }
+        IT_ASSERT(graph.topo_sort());
+        return total;
+    }
+
+    namespace
+    {
+        struct OpKey
+        {
+            vector<int> attrs;
+            vector<TensorObj *> inputs;
+
+            bool operator==(const OpKey &rhs) const
+            {
+                return attrs == rhs.attrs && inputs == rhs.inputs;
+            }
+        };
+
+        struct OpKeyHash
+        {
+            size_t operator()(const OpKey &key) const
+            {
+                size_t seed = key.attrs.size();
+                auto combine = [&](size_t value)
+                { seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2); };
+                for (auto attr : key.attrs)
+                    combine(std::hash<int>()(attr));
+                for (auto input : key.inputs)
+                    combine(std::hash<TensorObj *>()(input));
+                return seed;
+            }
+        };
+    } // namespace
+
+    size_t eliminateCommonSubexpressions(GraphObj &graph)
+    {
+        IT_ASSERT(graph.topo_sort());
+        // In topological order the inputs of an op are already merged when
+        // it is looked up, so duplicated chains merge in one pass.
+        std::unordered_map<OpKey, Operator, OpKeyHash> seen;
+        OpVec duplicates;
+        OpVec ops = graph.getOperators();
+        for (auto &op : ops)
+        {
+            OpKey key{op->getOpAttrVector(), {}};
+            for (auto &input : op->getInputs())
+                key.inputs.emplace_back(input.get());
+            auto [it, inserted] = seen.emplace(std::move(key), op);
+            if (inserted)
+                continue;
+            auto &kept = it->second;
+            const auto &outputs = op->getOutputs();
+            bool mergeable = outputs.size() == kept->getOutputs().size();
+            for (size_t i = 0; mergeable && i < outputs.size(); ++i)
+            {
+                const auto &output = outputs[i];
+                const auto &keptOutput = kept->getOutput(i);
+                // Rewiring the consumers onto a graph output would turn it
+                // into an intermediate, and later rules could erase it.
+                mergeable = !output->getTargets().empty() &&
+                            !keptOutput->getTargets().empty() &&
+                            output->getDims() == keptOutput->getDims() &&
+                            output->getDType() == keptOutput->getDType();
+            }
+            if (!mergeable)
+                continue;
+            for (size_t i = 0; i < outputs.size(); ++i)
+                graph.replaceAllUses(outputs[i], kept->getOutput(i));
+            duplicates.emplace_back(op);
+        }
+        for (auto &op : duplicates)
+            graph.eraseOperator(op);
+        return duplicates.size();
+    }
+
+    void RewriteEngine::printStats() const
+    {
+        for (auto &s : stats)
+        {
+            std::cout << "Rule " << s.name << ": " << s.hits << " hits, "
+                      << s.matches << " matches, " << s.ms << " ms"
+                      << std::endl;
+        }
+    }
+
+} // namespace infini
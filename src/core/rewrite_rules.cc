@@ -0,0 +1,1355 @@
+#include "core/graph_rewrite.h"
+#include "operators/concat.h"
+#include "operators/element_wise.h"
+#include "operators/fused_element_wise.h"
+#include "operators/matmul.h"
+#include "operators/split.h"
+#include "operators/transpose.h"
+#include "operators/unary.h"
+#include "utils/data_convert.h"
+#include "utils/operator_utils.h"
+#include <limits>
+#include <map>
+#include <numeric>
+#include <set>
+
+namespace infini
+{
+    namespace
+    {
+        // ========================== 代数化简 ==========================
+        //   x + 0, 0 + x, x - 0, x * 1, 1 * x, x / 1  →  x
+        //   x / c  →  x * (1 / c)
+        //   Relu(Relu(x)), Clip(Clip(x)), Relu(Clip(x)), Clip(Relu(x))
+        //     →  一个 Clip（上下界取交集），或 Relu
+        // 常量指已有数据的权重，所以这些规则在权重加载后才生效。每删掉一个
+        // 算子就省去一次对整个张量的读写，乘法也比除法便宜。
+        // =================================================================
+
+        // Whether `tensor` is a weight with data whose elements all equal
+        // `value`.
+        bool isConstant(const Tensor &tensor, float value)
+        {
+            if (!tensor->isWeight() || !tensor->hasData())
+                return false;
+            size_t size = tensor->size();
+            if (tensor->getDType() == DataType::Float32)
+            {
+                auto ptr = tensor->getRawDataPtr<float *>();
+                return std::all_of(ptr, ptr + size,
+                                   [value](float v) { return v == value; });
+            }
+            if (tensor->getDType() == DataType::UInt32)
+            {
+                auto ptr = tensor->getRawDataPtr<uint32_t *>();
+                return std::all_of(ptr, ptr + size, [value](uint32_t v)
+                                   { return v == uint32_t(value); });
+            }
+            return false;
+        }
+
+        // x op c == x, where input `constIndex` is the constant c
+        RewriteRule removeIdentityElementWise(const char *name, OpType type,
+                                              size_t constIndex, float identity)
+        {
+            auto isIdentity = [constIndex, identity](const Operator &op)
+            {
+                auto x = op->getInputs(1 - constIndex);
+                auto y = op->getOutput();
+                // the constant must not broadcast x; a graph output is kept
+                return !y->getTargets().empty() && x->getDims() == y->getDims() &&
+                       x->getDType() == y->getDType() &&
+                       isConstant(op->getInputs(constIndex), identity);
+            };
+            return {name, Pattern(type).where(isIdentity),
+                    [constIndex](GraphObj &g, const OpVec &m)
+                    {
+                        g.replaceAllUses(m[0]->getOutput(),
+                                         m[0]->getInputs(1 - constIndex));
+                        g.eraseOperator(m[0]);
+                        return true;
+                    }};
+        }
+
+        RewriteRule divToMulReciprocal()
+        {
+            auto isFloatConstant = [](const Operator &op)
+            {
+                auto c = op->getInputs(1);
+                if (!(op->getOutput()->getDType() == DataType::Float32) ||
+                    !(c->getDType() == DataType::Float32) || !c->isWeight() ||
+                    !c->hasData() || c == op->getInputs(0))
+                    return false;
+                auto ptr = c->getRawDataPtr<float *>();
+                return std::none_of(ptr, ptr + c->size(),
+                                    [](float v) { return v == 0; });
+            };
+            // Divs sharing a divisor share its reciprocal. The cache holds
+            // the divisor, so its address is not reused by another tensor.
+            auto reciprocals = std::make_shared<
+                std::unordered_map<TensorObj *, pair<Tensor, Tensor>>>();
+            return {"DivToMulReciprocal",
+                    Pattern(OpType::Div).where(isFloatConstant),
+                    [reciprocals](GraphObj &g, const OpVec &m)
+                    {
+                        auto &div = m[0];
+                        auto c = div->getInputs(1);
+                        auto &[source, r] = (*reciprocals)[c.get()];
+                        if (!source || !g.hasTensor(r))
+                        {
+                            source = c;
+                            r = g.addConstant(c->getDims(), DataType::Float32);
+                            auto src = c->getRawDataPtr<float *>();
+                            auto dst = r->getRawDataPtr<float *>();
+                            for (size_t i = 0; i < c->size(); ++i)
+                                dst[i] = 1 / src[i];
+                        }
+                        g.addOpWithOutputs<MulObj>(div->getInputs(0), r,
+                                                   div->getOutput());
+                        // c leaves the graph with its last Div
+                        g.eraseOperator(div);
+                        return true;
+                    }};
+        }
+
+        // The bounds of a Relu or Clip, infinite when open.
+        pair<float, float> clampBounds(const Operator &op)
+        {
+            constexpr float inf = std::numeric_limits<float>::infinity();
+            if (op->getOpType() == OpType::Relu)
+                return {0.f, inf};
+            auto clip = as<ClipObj>(op);
+            return {clip->getMin().value_or(-inf), clip->getMax().value_or(inf)};
+        }
+
+        RewriteRule mergeClamps(OpType outerType, OpType innerType)
+        {
+            return {string("Merge") + outerType.toString() + innerType.toString(),
+                    Pattern(outerType).input(0, Pattern(innerType)),
+                    [](GraphObj &g, const OpVec &m)
+                    {
+                        auto &outer = m[0], &inner = m[1];
+                        auto [a1, b1] = clampBounds(inner);
+                        auto [a2, b2] = clampBounds(outer);
+                        if (a1 > b1 || a2 > b2)
+                            return false;
+                        // Clip(Clip(x, a1, b1), a2, b2) == Clip(x, lo, hi)
+                        float lo = std::min(std::max(a1, a2), b2);
+                        float hi = std::min(std::max(b1, a2), b2);
+                        auto x = inner->getInputs(0);
+                        if (lo == 0 && std::isinf(hi))
+                            g.addOpWithOutputs<ReluObj>(x, outer->getOutput());
+                        else
+                            g.addOpWithOutputs<ClipObj>(
+                                x, outer->getOutput(),
+                                std::isinf(lo) ? std::nullopt : optional(lo),
+                                std::isinf(hi) ? std::nullopt : optional(hi));
+                        g.eraseOperator(outer);
+                        if (inner->getOutput()->getTargets().empty())
+                            g.eraseOperator(inner);
+                        return true;
+                    }};
+        }
+
+        // ========================== Cast 化简 ==========================
+        //   x → [Cast T→T] → y                     ⇒  x
+        //   x → [Cast T→U] → t → [Cast U→T] → y    ⇒  x   （T→U 无损）
+        //   x → [Transpose/Concat] → t → [Cast] → y
+        //                               ⇒  x → [Transpose/Concat，边搬运边转换] → y
+        //   x → [Cast] → t → [Transpose] → y  ⇒  同上
+        //   x → [逐元素算子] → t → [Cast] → y  ⇒  x → [FusedElementWise，写出时转换] → y
+        // 每去掉一个 Cast 就省去一次对整个张量的读写。Transpose 和 Concat
+        // 只搬运数据，输出类型可以与输入不同，由 kernel 转换。
+        // =================================================================
+
+        // Whether the output of `op` has another type than its first input,
+        // e.g. a Transpose with a Cast folded in.
+        bool convertsType(const Operator &op)
+        {
+            return !(op->getOutput()->getDType() == op->getInputs(0)->getDType());
+        }
+
+        // Whether every value of `from` survives a cast to `to` and back.
+        bool isLosslessCast(DataType from, DataType to)
+        {
+            static const vector<pair<DataType, DataType>> widening{
+                {DataType::Int8, DataType::Int16},
+                {DataType::Int8, DataType::Int32},
+                {DataType::Int8, DataType::Int64},
+                {DataType::Int8, DataType::Float32},
+                {DataType::UInt8, DataType::Int16},
+                {DataType::UInt8, DataType::Int32},
+                {DataType::UInt8, DataType::Int64},
+                {DataType::UInt8, DataType::Float32},
+                {DataType::Int16, DataType::Int32},
+                {DataType::Int16, DataType::Int64},
+                {DataType::Int16, DataType::Float32},
+                {DataType::Int32, DataType::Int64},
+                {DataType::UInt32, DataType::Int64},
+                {DataType::Float16, DataType::Float32},
+                {DataType::BFloat16, DataType::Float32},
+            };
+            return from == to ||
+                   std::any_of(widening.begin(), widening.end(),
+                               [&](const pair<DataType, DataType> &cast)
+                               { return cast.first == from && cast.second == to; });
+        }
+
+        RewriteRule removeIdentityCast()
+        {
+            return {"RemoveIdentityCast",
+                    Pattern(OpType::Cast).where(
+                        [](const Operator &op)
+                        {
+                            return !convertsType(op) &&
+                                   !op->getOutput()->getTargets().empty();
+                        }),
+                    [](GraphObj &g, const OpVec &m)
+                    {
+                        g.replaceAllUses(m[0]->getOutput(), m[0]->getInputs(0));
+                        g.eraseOperator(m[0]);
+                        return true;
+                    }};
+        }
+
+        RewriteRule removeRoundTripCast()
+        {
+            auto isRoundTrip = [](const Operator &op)
+            {
+                auto inner = op->getInputs(0)->getSource();
+                auto x = inner->getInputs(0);
+                return op->getOutput()->getDType() == x->getDType() &&
+                       isLosslessCast(x->getDType(), inner->getOutput()->getDType()) &&
+                       !op->getOutput()->getTargets().empty();
+            };
+            return {"RemoveRoundTripCast",
+                    Pattern(OpType::Cast)
+                        .input(0, Pattern(OpType::Cast))
+                        .where(isRoundTrip),
+                    [](GraphObj &g, const OpVec &m)
+                    {
+                        auto &outer = m[0], &inner = m[1];
+                        g.replaceAllUses(outer->getOutput(), inner->getInputs(0));
+                        g.eraseOperator(outer);
+                        if (inner->getOutput()->getTargets().empty())
+                            g.eraseOperator(inner);
+                        return true;
+                    }};
+        }
+
+        // Whether a kernel can convert from the input type of `op` to the
+        // output type of `cast` as it moves the data.
+        bool canConvert(const Operator &op, const Operator &cast)
+        {
+            return is_convertible(op->getInputs(0)->getDType()) &&
+                   is_convertible(cast->getOutput()->getDType());
+        }
+
+        RewriteRule foldCastIntoProducer(OpType type)
+        {
+            return {string("FoldCastInto") + type.toString(),
+                    Pattern(OpType::Cast)
+                        .input(0, Pattern(type).singleUse().where(
+                                      [](const Operator &op)
+                                      { return !convertsType(op); }))
+                        .where([](const Operator &op)
+                               { return canConvert(op->getInputs(0)->getSource(), op); }),
+                    [type](GraphObj &g, const OpVec &m)
+                    {
+                        auto &cast = m[0], &producer = m[1];
+                        if (type == OpType::Transpose)
+                            g.addOpWithOutputs<TransposeObj>(
+                                producer->getInputs(0), cast->getOutput(),
+                                as<TransposeObj>(producer)->getPermute());
+                        else
+                            g.addOpWithOutputs<ConcatObj>(
+                                producer->getInputs(), cast->getOutput(),
+                                as<ConcatObj>(producer)->getDim());
+                        g.eraseOperator(cast);
+                        g.eraseOperator(producer);
+                        return true;
+                    }};
+        }
+
+        RewriteRule foldCastIntoTranspose()
+        {
+            return {"FoldCastIntoNextTranspose",
+                    Pattern(OpType::Transpose)
+                        .input(0, Pattern(OpType::Cast).singleUse())
+                        .where([](const Operator &op)
+                               {
+                                   auto cast = op->getInputs(0)->getSource();
+                                   return !convertsType(op) && canConvert(cast, op);
+                               }),
+                    [](GraphObj &g, const OpVec &m)
+                    {
+                        auto transpose = as<TransposeObj>(m[0]);
+                        auto &cast = m[1];
+                        g.addOpWithOutputs<TransposeObj>(cast->getInputs(0),
+                                                         transpose->getOutput(),
+                                                         transpose->getPermute());
+                        g.eraseOperator(transpose);
+                        g.eraseOperator(cast);
+                        return true;
+                    }};
+        }
+
+        // ===================== 合并相邻的 Transpose =====================
+        //   优化前: x → [Transpose p1] → t → [Transpose p2] → y
+        //   优化后: x → [Transpose p] → y,  p[i] = p1[p2[i]]
+        // y 的第 i 维是 t 的第 p2[i] 维，即 x 的第 p1[p2[i]] 维。第二个
+        // Transpose 改为直接读 x；第一个若不再有使用者则删除，否则保留给
+        // 其他使用者。合并后若为恒等排列，由下面的规则删除。
+        // =================================================================
+        RewriteRule composeTransposes()
+        {
+            return {"ComposeTransposes",
+                    Pattern(OpType::Transpose)
+                        .input(0, Pattern(OpType::Transpose))
+                        .where([](const Operator &op)
+                               {
+                                   // one conversion at most, kept at the end
+                                   return !convertsType(op) ||
+                                          !convertsType(op->getInputs(0)->getSource());
+                               }),
+                    [](GraphObj &g, const OpVec &m)
+                    {
+                        auto outer = as<TransposeObj>(m[0]);
+                        auto inner = as<TransposeObj>(m[1]);
+                        auto p1 = inner->getPermute(), p2 = outer->getPermute();
+                        vector<int> p(p2.size());
+                        for (size_t i = 0; i < p2.size(); ++i)
+                            p[i] = p1[p2[i]];
+                        g.replaceInput(outer, inner->getOutput(),
+                                       inner->getInputs(0));
+                        outer->setPermute(p);
+                        if (inner->getOutput()->getTargets().empty())
+                            g.eraseOperator(inner);
+                        return true;
+                    }};
+        }
+
+        // ===================== 去除恒等的 Transpose =====================
+        // 排列为 {0, 1, ..., n-1} 的 Transpose 只是一次拷贝，让使用者直接读
+        // 它的输入。图的输出没有使用者可以改写，保留。
+        // =================================================================
+        bool isIdentityPermute(const vector<int> &perm)
+        {
+            for (size_t i = 0; i < perm.size(); ++i)
+            {
+                if (perm[i] != (int)i)
+                    return false;
+            }
+            return true;
+        }
+
+        RewriteRule removeIdentityTranspose()
+        {
+            auto isIdentity = [](const Operator &op)
+            {
+                return isIdentityPermute(as<TransposeObj>(op)->getPermute()) &&
+                       !convertsType(op) && !op->getOutput()->getTargets().empty();
+            };
+            return {"RemoveIdentityTranspose",
+                    Pattern(OpType::Transpose).where(isIdentity),
+                    [](GraphObj &g, const OpVec &m)
+                    {
+                        g.replaceAllUses(m[0]->getOutput(),
+                                         m[0]->getInputs(0));
+                        g.eraseOperator(m[0]);
+                        return true;
+                    }};
+        }
+
+        // ===================== Transpose 下沉 =====================
+        //   优化前: x → [Transpose p] → t → [Relu] → y
+        //   优化后: x → [Relu] → u → [Transpose p] → y
+        // 逐元素算子与布局无关，先算再转置结果不变。让 Transpose 越过
+        // Relu/Clip/Cast、两个输入都以同一排列转置（或另一输入只有一个
+        // 元素）的 Add/Sub/Mul/Div，以及输入都以同一排列转置的 Concat（轴
+        // 变为 p[axis]），它就能遇到 Matmul 或另一个 Transpose，由上面和
+        // 下面的规则消掉。多个输入的 Transpose 合成一个；Cast 只在不变宽
+        // 时越过，转置更少的字节。恒等的 Transpose 由上面的规则删除；单输入
+        // 算子若输出是图的输出，下沉没有收益，不做。
+        // =================================================================
+
+        // The permutation of the single-use Transpose producing `tensor`.
+        optional<vector<int>> sinkablePermute(const Tensor &tensor)
+        {
+            auto source = tensor->getSource();
+            if (!source || source->getOpType() != OpType::Transpose ||
+                source->getOutput()->getTargets().size() != 1 ||
+                convertsType(source))
+                return std::nullopt;
+            auto perm = as<TransposeObj>(source)->getPermute();
+            if (isIdentityPermute(perm))
+                return std::nullopt;
+            return perm;
+        }
+
+        // Apply a copy of `op` to `inputs` as a new operator.
+        Tensor reapply(GraphObj &g, const Operator &op, const TensorVec &inputs)
+        {
+            const auto &x = inputs[0];
+            switch (op->getOpType().underlying())
+            {
+            case OpType::Add:
+                return g.addOp<AddObj>(x, inputs[1], nullptr)->getOutput();
+            case OpType::Sub:
+                return g.addOp<SubObj>(x, inputs[1], nullptr)->getOutput();
+            case OpType::Mul:
+                return g.addOp<MulObj>(x, inputs[1], nullptr)->getOutput();
+            case OpType::Div:
+                return g.addOp<DivObj>(x, inputs[1], nullptr)->getOutput();
+            case OpType::Relu:
+                return g.addOp<ReluObj>(x, nullptr)->getOutput();
+            case OpType::Clip:
+            {
+                auto clip = as<ClipObj>(op);
+                return g.addOp<ClipObj>(x, nullptr, clip->getMin(),
+                                        clip->getMax())
+                    ->getOutput();
+            }
+            case OpType::Cast:
+                return g.addOp<CastObj>(x, nullptr, as<CastObj>(op)->getType())
+                    ->getOutput();
+            default:
+                IT_TODO_HALT();
+            }
+        }
+
+        // Erase the Transposes that fed the rewritten op.
+        void eraseSunkTransposes(GraphObj &g, const TensorVec &inputs)
+        {
+            for (auto &input : inputs)
+            {
+                auto source = input->getSource();
+                if (source && g.hasOperator(source) &&
+                    input->getTargets().empty())
+                    g.eraseOperator(source);
+            }
+        }
+
+        RewriteRule sinkTransposeThroughUnary(OpType type)
+        {
+            auto sinkable = [](const Operator &op)
+            {
+                return sinkablePermute(op->getInputs(0)) &&
+                       !op->getOutput()->getTargets().empty() &&
+                       op->getOutput()->getDType().getSize() <=
+                           op->getInputs(0)->getDType().getSize();
+            };
+            return {string("SinkTransposeThrough") + type.toString(),
+                    Pattern(type)
+                        .input(0, Pattern(OpType::Transpose).singleUse())
+                        .where(sinkable),
+                    [](GraphObj &g, const OpVec &m)
+                    {
+                        auto &op = m[0];
+                        auto transpose = as<TransposeObj>(m[1]);
+                        auto u = reapply(g, op, {transpose->getInputs(0)});
+                        g.addOpWithOutputs<TransposeObj>(u, op->getOutput(),
+                                                         transpose->getPermute());
+                        g.eraseOperator(op);
+                        eraseSunkTransposes(g, {transpose->getOutput()});
+                        return true;
+                    }};
+        }
+
+        RewriteRule sinkTransposeThroughBinary(OpType type, size_t index)
+        {
+            // the other input is transposed the same way, or has one element
+            // and a rank that does not grow the output. The latter only moves
+            // the Transpose, so like the unary case it keeps graph outputs.
+            auto sinkable = [index](const Operator &op)
+            {
+                auto permute = sinkablePermute(op->getInputs(index));
+                if (!permute)
+                    return false;
+                auto &perm = *permute;
+                auto other = op->getInputs(1 - index);
+                if (other->size() == 1)
+                    return other->getRank() <= perm.size() &&
+                           !op->getOutput()->getTargets().empty();
+                return index == 0 && sinkablePermute(other) == perm;
+            };
+            return {string("SinkTransposeThrough") + type.toString() +
+                        (index == 0 ? "A" : "B"),
+                    Pattern(type)
+                        .input(index, Pattern(OpType::Transpose).singleUse())
+                        .where(sinkable),
+                    [index](GraphObj &g, const OpVec &m)
+                    {
+                        auto &op = m[0];
+                        auto transpose = as<TransposeObj>(m[1]);
+                        TensorVec inputs = op->getInputs();
+                        auto &other = inputs[1 - index];
+                        inputs[index] = transpose->getInputs(0);
+                        if (other->size() != 1)
+                            other = other->getSource()->getInputs(0);
+                        auto u = reapply(g, op, inputs);
+                        g.addOpWithOutputs<TransposeObj>(u, op->getOutput(),
+                                                         transpose->getPermute());
+                        g.eraseOperator(op);
+                        eraseSunkTransposes(g, op->getInputs());
+                        return true;
+                    }};
+        }
+
+        RewriteRule sinkTransposeThroughConcat()
+        {
+            auto sameTranspose = [](const Operator &op)
+            {
+                auto perm = sinkablePermute(op->getInputs(0));
+                for (auto &input : op->getInputs())
+                {
+                    if (!perm || sinkablePermute(input) != perm)
+                        return false;
+                }
+                return true;
+            };
+            return {"SinkTransposeThroughConcat",
+                    Pattern(OpType::Concat).where(sameTranspose),
+                    [](GraphObj &g, const OpVec &m)
+                    {
+                        auto concat = as<ConcatObj>(m[0]);
+                        auto perm = *sinkablePermute(concat->getInputs(0));
+                        TensorVec inputs;
+                        for (auto &input : concat->getInputs())
+                            inputs.emplace_back(input->getSource()->getInputs(0));
+                        auto u = g.addOp<ConcatObj>(inputs, nullptr,
+                                                    perm[concat->getDim()])
+                                     ->getOutput();
+                        g.addOpWithOutputs<TransposeObj>(u, concat->getOutput(),
+                                                         perm);
+                        g.eraseOperator(concat);
+                        eraseSunkTransposes(g, concat->getInputs());
+                        return true;
+                    }};
+        }
+
+        // ================== 将 Transpose 融合到 Matmul 中 ==================
+        //   优化前: x → [Transpose {..., n-1, n-2}] → t → [Matmul(A, B)]
+        //   优化后: x ─────────────────────────────────→ [Matmul(A, B^T)]
+        // 只交换最后两维的 Transpose 可以由 Matmul 的 transA/transB 属性代替。
+        // =================================================================
+        bool isLastTwoDimSwap(const Operator &op)
+        {
+            auto perm = as<TransposeObj>(op)->getPermute();
+            int rank = perm.size();
+            if (rank < 2 || convertsType(op))
+                return false;
+            for (int i = 0; i < rank - 2; ++i)
+            {
+                if (perm[i] != i)
+                    return false;
+            }
+            return perm[rank - 1] == rank - 2 && perm[rank - 2] == rank - 1;
+        }
+
+        RewriteRule foldTransposeIntoMatmul(size_t index)
+        {
+            return {index == 0 ? "FoldTransposeIntoMatmulA"
+                               : "FoldTransposeIntoMatmulB",
+                    Pattern(OpType::MatMul)
+                        .input(index, Pattern(OpType::Transpose)
+                                          .where(isLastTwoDimSwap))
+                        .where([index](const Operator &op)
+                               {
+                                   // replaceInput rewires every use of it
+                                   auto &inputs = op->getInputs();
+                                   return std::count(inputs.begin(), inputs.end(),
+                                                     inputs[index]) == 1;
+                               }),
+                    [index](GraphObj &g, const OpVec &m)
+                    {
+                        auto matmul = as<MatmulObj>(m[0]);
+                        auto &transpose = m[1];
+                        if (index == 0)
+                            matmul->setTransA(!matmul->getTransA());
+                        else
+                            matmul->setTransB(!matmul->getTransB());
+                        g.replaceInput(matmul, transpose->getOutput(),
+                                       transpose->getInputs(0));
+                        if (transpose->getOutput()->getTargets().empty())
+                            g.eraseOperator(transpose);
+                        return true;
+                    }};
+        }
+
+        // ===================== Matmul 链重排（结合律） =====================
+        //   优化前: A[64x2] · B[2x64] → t[64x64] → t · C[64x2]    16384 次乘加
+        //   优化后: A · (B · C)                               512 次乘加
+        // 中间结果只被一个 Matmul 使用的 Matmul 构成一条链。按经典的矩阵链
+        // 动态规划求代价最小的加括号方式，代价计入广播后的 batch 大小；只有
+        // 比原顺序便宜才重建。链内的 transA/transB 只能出现在叶子上，中间
+        // 结果带转置或 epilogue 时不再向下展开；根的 epilogue 保留给新的根。
+        // =================================================================
+
+        // The batch dims of a product of operands with batch dims `a` and
+        // `b`, broadcast like MatmulObj::inferShape.
+        Shape broadcastBatch(const Shape &a, const Shape &b)
+        {
+            if (a.empty() || b.empty())
+                return a.empty() ? b : a;
+            return infer_broadcast(a, b);
+        }
+
+        // Whether input `index` of `matmul` is an intermediate of the chain.
+        bool expandsChain(const Ref<MatmulObj> &matmul, size_t index)
+        {
+            auto input = matmul->getInputs(index);
+            auto source = input->getSource();
+            if ((index == 0 ? matmul->getTransA() : matmul->getTransB()) ||
+                !source || source->getOpType() != OpType::MatMul ||
+                as<MatmulObj>(source)->hasEpilogue() ||
+                input->getTargets().size() != 1 ||
+                matmul->getInputs(1 - index) == input)
+                return false;
+            for (auto &operand : source->getInputs())
+            {
+                if (!(operand->getDType() == input->getDType()))
+                    return false;
+            }
+            return true;
+        }
+
+        struct MatmulChain
+        {
+            struct Leaf
+            {
+                Tensor tensor;
+                bool trans;
+                size_t rows, cols;
+                Shape batch;
+            };
+            vector<Leaf> leaves;
+            OpVec ops;           // root first
+            double originalCost; // multiply-adds in the current order
+
+            // Collect the chain under `matmul`; returns the batch dims of
+            // its result.
+            Shape collect(const Ref<MatmulObj> &matmul)
+            {
+                ops.emplace_back(matmul);
+                size_t first = leaves.size(), mid = 0;
+                Shape batch;
+                for (size_t i = 0; i < 2; ++i)
+                {
+                    if (i == 1)
+                        mid = leaves.size() - 1; // the last leaf of A
+                    if (expandsChain(matmul, i))
+                    {
+                        batch = broadcastBatch(
+                            batch,
+                            collect(as<MatmulObj>(matmul->getInputs(i)->getSource())));
+                        continue;
+                    }
+                    auto tensor = matmul->getInputs(i);
+                    auto dims = tensor->getDims();
+                    bool trans = i == 0 ? matmul->getTransA() : matmul->getTransB();
+                    size_t r = dims[dims.size() - 2], c = dims[dims.size() - 1];
+                    Shape leafBatch(dims.begin(), dims.end() - 2);
+                    leaves.push_back({tensor, trans, trans ? c : r, trans ? r : c,
+                                      leafBatch});
+                    batch = broadcastBatch(batch, leafBatch);
+                }
+                originalCost += cost(batch, leaves[first].rows,
+                                     leaves.back().cols, leaves[mid].cols);
+                return batch;
+            }
+
+            static double cost(const Shape &batch, size_t m, size_t n, size_t k)
+            {
+                double size = 1;
+                for (auto d : batch)
+                    size *= d;
+                return size * m * n * k;
+            }
+        };
+
+        RewriteRule reorderMatmulChain()
+        {
+            // the root of a chain of at least three operands
+            auto isChainRoot = [](const Operator &op)
+            {
+                auto matmul = as<MatmulObj>(op);
+                auto targets = op->getOutput()->getTargets();
+                if (targets.size() == 1 &&
+                    targets[0]->getOpType() == OpType::MatMul)
+                {
+                    auto consumer = as<MatmulObj>(targets[0]);
+                    for (size_t i = 0; i < 2; ++i)
+                    {
+                        if (consumer->getInputs(i) == op->getOutput() &&
+                            expandsChain(consumer, i))
+                            return false;
+                    }
+                }
+                return expandsChain(matmul, 0) || expandsChain(matmul, 1);
+            };
+            return {"ReorderMatmulChain",
+                    Pattern(OpType::MatMul).where(isChainRoot),
+                    [](GraphObj &g, const OpVec &m)
+                    {
+                        auto root = as<MatmulObj>(m[0]);
+                        MatmulChain chain{{}, {}, 0};
+                        chain.collect(root);
+                        const auto &leaves = chain.leaves;
+                        size_t n = leaves.size();
+                        // batch[i][j]: batch dims of the product of leaves i..j
+                        vector<vector<Shape>> batch(n, vector<Shape>(n));
+                        vector<vector<double>> best(n, vector<double>(n, 0));
+                        vector<vector<size_t>> split(n, vector<size_t>(n, 0));
+                        for (size_t i = 0; i < n; ++i)
+                            batch[i][i] = leaves[i].batch;
+                        for (size_t len = 2; len <= n; ++len)
+                        {
+                            for (size_t i = 0, j = len - 1; j < n; ++i, ++j)
+                            {
+                                batch[i][j] = broadcastBatch(batch[i][j - 1],
+                                                             leaves[j].batch);
+                                best[i][j] = std::numeric_limits<double>::infinity();
+                                for (size_t s = i; s < j; ++s)
+                                {
+                                    double c = best[i][s] + best[s + 1][j] +
+                                               MatmulChain::cost(
+                                                   batch[i][j], leaves[i].rows,
+                                                   leaves[j].cols, leaves[s].cols);
+                                    if (c < best[i][j])
+                                    {
+                                        best[i][j] = c;
+                                        split[i][j] = s;
+                                    }
+                                }
+                            }
+                        }
+                        if (best[0][n - 1] >= chain.originalCost)
+                            return false;
+                        // the new root writes the old output with its epilogue
+                        std::function<pair<Tensor, bool>(size_t, size_t)> build =
+                            [&](size_t i, size_t j) -> pair<Tensor, bool>
+                        {
+                            if (i == j)
+                                return {leaves[i].tensor, leaves[i].trans};
+                            auto [a, transA] = build(i, split[i][j]);
+                            auto [b, transB] = build(split[i][j] + 1, j);
+                            if (i == 0 && j == n - 1)
+                                return {g.addOpWithOutputs<MatmulObj>(
+                                             a, b, root->getOutput(), transA,
+                                             transB, root->getBias(),
+                                             root->getAct(), root->getMin(),
+                                             root->getMax())
+                                            ->getOutput(),
+                                        false};
+                            return {g.addOp<MatmulObj>(a, b, nullptr, transA, transB)
+                                        ->getOutput(),
+                                    false};
+                        };
+                        build(0, n - 1);
+                        for (auto &op : chain.ops)
+                            g.eraseOperator(op);
+                        return true;
+                    }};
+        }
+
+        // ===================== Matmul 尾处理（epilogue）融合 =====================
+        //   优化前: A, B → [Matmul] → c → [Add(c, bias)] → d → [Relu] → y
+        //   优化后: A, B, bias → [Matmul(bias, act=Relu)] → y
+        // Matmul 的输出只被 Add/Relu/Clip 使用时，把它们并入 Matmul，由 kernel
+        // 在输出行还在 L1 时完成，省去对输出的两次完整读写。偏置只能沿最后
+        // 两维广播；激活之后不能再加偏置。
+        // =================================================================
+        bool canTakeEpilogue(const Operator &op)
+        {
+            auto matmul = as<MatmulObj>(op);
+            return matmul->getAct() == ActType::None;
+        }
+
+        // Replace `matmul` by a copy writing `output` with the given epilogue.
+        void rebuildMatmul(GraphObj &g, const Ref<MatmulObj> &matmul,
+                           const Tensor &output, const Tensor &bias, ActType act,
+                           std::optional<float> min, std::optional<float> max)
+        {
+            g.addOpWithOutputs<MatmulObj>(
+                matmul->getInputs(0), matmul->getInputs(1), output,
+                matmul->getTransA(), matmul->getTransB(), bias, act, min, max);
+        }
+
+        RewriteRule fuseMatmulBias(size_t index)
+        {
+            auto isRowBias = [index](const Operator &op)
+            {
+                auto c = op->getInputs(index);
+                auto bias = op->getInputs(1 - index);
+                auto matmul = as<MatmulObj>(c->getSource());
+                if (matmul->getBias() || bias == c ||
+                    !(bias->getDType() == c->getDType()))
+                    return false;
+                // the bias broadcasts to C without changing its shape
+                auto dims = bias->getDims();
+                int rank = dims.size();
+                for (int i = 0; i < rank - 2; ++i)
+                {
+                    if (dims[i] != 1)
+                        return false;
+                }
+                return op->getOutput()->getDims() == c->getDims();
+            };
+            return {index == 0 ? "FuseMatmulBiasA" : "FuseMatmulBiasB",
+                    Pattern(OpType::Add)
+                        .input(index, Pattern(OpType::MatMul)
+                                          .singleUse()
+                                          .where(canTakeEpilogue))
+                        .where(isRowBias),
+                    [index](GraphObj &g, const OpVec &m)
+                    {
+                        auto &add = m[0];
+                        auto matmul = as<MatmulObj>(m[1]);
+                        rebuildMatmul(g, matmul, add->getOutput(),
+                                      add->getInputs(1 - index), ActType::None,
+                                      std::nullopt, std::nullopt);
+                        g.eraseOperator(add);
+                        g.eraseOperator(matmul);
+                        return true;
+                    }};
+        }
+
+        RewriteRule fuseMatmulActivation(OpType type)
+        {
+            return {type == OpType::Relu ? "FuseMatmulRelu" : "FuseMatmulClip",
+                    Pattern(type).input(
+                        0, Pattern(OpType::MatMul).singleUse().where(
+                               canTakeEpilogue)),
+                    [type](GraphObj &g, const OpVec &m)
+                    {
+                        auto &act = m[0];
+                        auto matmul = as<MatmulObj>(m[1]);
+                        if (type == OpType::Relu)
+                            rebuildMatmul(g, matmul, act->getOutput(),
+                                          matmul->getBias(), ActType::Relu,
+                                          std::nullopt, std::nullopt);
+                        else
+                            rebuildMatmul(g, matmul, act->getOutput(),
+                                          matmul->getBias(), ActType::Clip,
+                                          as<ClipObj>(act)->getMin(),
+                                          as<ClipObj>(act)->getMax());
+                        g.eraseOperator(act);
+                        g.eraseOperator(matmul);
+                        return true;
+                    }};
+        }
+
+        // ====================== 横向合并 Matmul ======================
+        //   优化前: A · Wq → q,  A · Wk → k,  A · Wv → v
+        //   优化后: A · [Wq Wk Wv] → t → [Split] → q, k, v
+        // 共享 A、B 为已有数据的二维权重的 Matmul，在准备阶段把权重（和偏置）
+        // 沿 N 拼接成一个常量，只读一遍 A，小 N 的 GEMM 也更高效。只在 M 为 1
+        // 时合并：此时 Split 的输出是结果的连续片段，不需要拷贝；M 更大时
+        // Split 要按行拷贝整个结果，反而多一遍读写。原来的权重随 Matmul 删掉，
+        // 其内存由 releaseDeadConstants 回收。
+        //
+        //   优化前: A1 · B1 → c1,  A2 · B2 → c2        （形状相同、互不依赖）
+        //   优化后: [A1; A2] · [B1; B2] → t → [Split 轴 0] → c1, c2
+        // 至少三维、batch 不广播的 Matmul 沿第 0 维拼成一个 batched Matmul，
+        // 两侧的 Concat 和 Split 都是连续片段，由 dataMalloc 消掉拷贝。
+        // =================================================================
+
+        // Concatenate weights with data into a new constant, like ConcatObj.
+        Tensor concatConstants(GraphObj &g, const TensorVec &tensors, int dim)
+        {
+            Shape dims = tensors[0]->getDims();
+            dims[dim] = 0;
+            for (auto &tensor : tensors)
+                dims[dim] += tensor->getDims()[dim];
+            auto result = g.addConstant(dims, tensors[0]->getDType());
+            size_t inner = result->getDType().getSize();
+            for (size_t i = dim + 1; i < dims.size(); ++i)
+                inner *= dims[i];
+            size_t outer = result->getBytes() / (inner * dims[dim]);
+            auto dst = result->getRawDataPtr<char *>();
+            for (size_t o = 0; o < outer; ++o)
+            {
+                for (auto &tensor : tensors)
+                {
+                    size_t block = inner * tensor->getDims()[dim];
+                    std::memcpy(dst, tensor->getRawDataPtr<char *>() + o * block,
+                                block);
+                    dst += block;
+                }
+            }
+            return result;
+        }
+
+        bool isConstantTensor(const Tensor &tensor)
+        {
+            return tensor->isWeight() && tensor->hasData();
+        }
+
+        bool sameEpilogueAct(const Ref<MatmulObj> &a, const Ref<MatmulObj> &b)
+        {
+            return a->getAct() == b->getAct() && a->getMin() == b->getMin() &&
+                   a->getMax() == b->getMax();
+        }
+
+        // Whether `other` reads the same A as `matmul` with a constant B that
+        // can be concatenated to its B along N.
+        bool sharesInput(const Ref<MatmulObj> &matmul,
+                         const Ref<MatmulObj> &other)
+        {
+            auto b = other->getInputs(1);
+            if (other->getInputs(0) != matmul->getInputs(0) || b->getRank() != 2 ||
+                !isConstantTensor(b) ||
+                !(b->getDType() == matmul->getInputs(1)->getDType()) ||
+                other->getTransA() != matmul->getTransA() ||
+                other->getTransB() != matmul->getTransB() ||
+                !sameEpilogueAct(matmul, other))
+                return false;
+            auto bias = other->getBias(), ref = matmul->getBias();
+            if (!bias || !ref)
+                return !bias && !ref;
+            // biases concatenate along their last dim, which must be N
+            auto dims = bias->getDims(), refDims = ref->getDims();
+            return isConstantTensor(bias) && bias->getRank() == ref->getRank() &&
+                   std::equal(dims.begin(), dims.end() - 1, refDims.begin()) &&
+                   (int)dims.back() == other->getOutput()->getDims().back() &&
+                   (int)refDims.back() == matmul->getOutput()->getDims().back();
+        }
+
+        // The Matmuls reading the same A as `op` that can merge with it.
+        vector<Ref<MatmulObj>> sharedInputGroup(const Operator &op)
+        {
+            auto matmul = as<MatmulObj>(op);
+            vector<Ref<MatmulObj>> group;
+            for (auto &target : op->getInputs(0)->getTargets())
+            {
+                if (target->getOpType() == OpType::MatMul &&
+                    sharesInput(matmul, as<MatmulObj>(target)))
+                    group.emplace_back(as<MatmulObj>(target));
+            }
+            return group;
+        }
+
+        RewriteRule fuseSharedInputMatmuls()
+        {
+            auto hasGroup = [](const Operator &op)
+            {
+                auto dims = op->getOutput()->getDims();
+                if (std::accumulate(dims.begin(), dims.end() - 1, 1,
+                                    std::multiplies{}) != 1)
+                    return false;
+                auto group = sharedInputGroup(op);
+                // the group is merged once, from its first member
+                return group.size() > 1 && group[0] == op;
+            };
+            return {"FuseSharedInputMatmuls",
+                    Pattern(OpType::MatMul).where(hasGroup),
+                    [](GraphObj &g, const OpVec &m)
+                    {
+                        auto group = sharedInputGroup(m[0]);
+                        auto &first = group[0];
+                        TensorVec weights, biases, outputs;
+                        vector<int> sizes;
+                        for (auto &matmul : group)
+                        {
+                            weights.emplace_back(matmul->getInputs(1));
+                            if (matmul->getBias())
+                                biases.emplace_back(matmul->getBias());
+                            outputs.emplace_back(matmul->getOutput());
+                            sizes.emplace_back(outputs.back()->getDims().back());
+                        }
+                        // N is the last dim of B, or the first when transposed
+                        auto weight = concatConstants(g, weights,
+                                                      first->getTransB() ? 0 : 1);
+                        Tensor bias = nullptr;
+                        if (!biases.empty())
+                            bias = concatConstants(g, biases,
+                                                   biases[0]->getRank() - 1);
+                        auto fused = g.addOp<MatmulObj>(
+                            first->getInputs(0), weight, nullptr,
+                            first->getTransA(), first->getTransB(), bias,
+                            first->getAct(), first->getMin(), first->getMax());
+                        auto rank = fused->getOutput()->getRank();
+                        g.addOpWithOutputs<SplitObj>(fused->getOutput(), outputs,
+                                                     rank - 1, sizes);
+                        for (auto &matmul : group)
+                            g.eraseOperator(matmul);
+                        return true;
+                    }};
+        }
+
+        // Whether `matmul` can be one of the matrices of a batched Matmul.
+        bool isBatchable(const Ref<MatmulObj> &matmul)
+        {
+            auto a = matmul->getInputs(0), b = matmul->getInputs(1);
+            auto aDims = a->getDims(), bDims = b->getDims();
+            // the batch dims of A, B and C match, nothing is broadcast
+            if (aDims.size() < 3 || aDims.size() != bDims.size() ||
+                matmul->getBias() || a == b ||
+                !std::equal(aDims.begin(), aDims.end() - 2, bDims.begin()))
+                return false;
+            // A is concatenated at run time, for free only when its producer
+            // can write into the Concat output, see GraphObj::dataMalloc. A
+            // constant B is concatenated once instead.
+            auto isActivation = [](const Tensor &t)
+            { return t->getSource() && !t->isWeight(); };
+            return isActivation(a) && (isActivation(b) || isConstantTensor(b));
+        }
+
+        using MatmulShapeKey =
+            std::tuple<Shape, Shape, int, int, bool, bool, bool, int,
+                       optional<float>, optional<float>>;
+
+        // Matmuls with equal keys compute on matrices of the same shape.
+        MatmulShapeKey matmulShapeKey(const Ref<MatmulObj> &matmul)
+        {
+            auto a = matmul->getInputs(0), b = matmul->getInputs(1);
+            return {a->getDims(),
+                    b->getDims(),
+                    a->getDType().getIndex(),
+                    b->getDType().getIndex(),
+                    isConstantTensor(b),
+                    matmul->getTransA(),
+                    matmul->getTransB(),
+                    (int)matmul->getAct(),
+                    matmul->getMin(),
+                    matmul->getMax()};
+        }
+
+        // Merge `group`, independent Matmuls of the same shape, into one
+        // Matmul over their matrices concatenated along the batch axis.
+        void batchMatmuls(GraphObj &g, const vector<Ref<MatmulObj>> &group)
+        {
+            auto &first = group[0];
+            TensorVec lhs, rhs, outputs;
+            vector<int> sizes;
+            for (auto &matmul : group)
+            {
+                lhs.emplace_back(matmul->getInputs(0));
+                rhs.emplace_back(matmul->getInputs(1));
+                outputs.emplace_back(matmul->getOutput());
+                sizes.emplace_back(outputs.back()->getDims()[0]);
+            }
+            auto a = g.addOp<ConcatObj>(lhs, nullptr, 0)->getOutput();
+            auto b = isConstantTensor(rhs[0])
+                         ? concatConstants(g, rhs, 0)
+                         : g.addOp<ConcatObj>(rhs, nullptr, 0)->getOutput();
+            auto c = g.addOp<MatmulObj>(a, b, nullptr, first->getTransA(),
+                                        first->getTransB(), nullptr,
+                                        first->getAct(), first->getMin(),
+                                        first->getMax())
+                         ->getOutput();
+            g.addOpWithOutputs<SplitObj>(c, outputs, 0, sizes);
+            for (auto &matmul : group)
+                g.eraseOperator(matmul);
+        }
+
+        // ====================== 逐元素算子链融合 ======================
+        //   优化前: a, b → [Add] → t → [Relu] → u → [Mul(u, c)] → y
+        //   优化后: a, b, c → [FusedElementWise: r3=Add(r0,r1);
+        //                      r4=Relu(r3);r5=Mul(r4,r2)] → y
+        // 一个逐元素算子的输入若只被它使用，且由另一个逐元素算子产生，则
+        // 把生产者的程序拼接到它前面。反复应用即可融合整条链（或树），
+        // 中间张量不再需要内存。
+        // =================================================================
+        constexpr size_t maxFusedInputs = 16, maxFusedInstrs = 64;
+
+        struct ElementWiseProgram
+        {
+            TensorVec inputs;
+            vector<ElementWiseInstr> instrs;
+        };
+
+        optional<ElementWiseProgram> toProgram(const Operator &op)
+        {
+            if (op->getOutputs().size() != 1)
+                return std::nullopt;
+            // the type computed in; only a fused op may write another one
+            auto dtype = op->getInputs(0)->getDType();
+            if (!(dtype == DataType::Float32 || dtype == DataType::UInt32) ||
+                (convertsType(op) && op->getOpType() != OpType::FusedElementWise))
+                return std::nullopt;
+            for (auto &input : op->getInputs())
+            {
+                if (!(input->getDType() == dtype))
+                    return std::nullopt;
+            }
+            switch (op->getOpType().underlying())
+            {
+            case OpType::Add:
+                return ElementWiseProgram{op->getInputs(),
+                                          {{ElementWiseInstr::Add, 0, 1}}};
+            case OpType::Sub:
+                return ElementWiseProgram{op->getInputs(),
+                                          {{ElementWiseInstr::Sub, 0, 1}}};
+            case OpType::Mul:
+                return ElementWiseProgram{op->getInputs(),
+                                          {{ElementWiseInstr::Mul, 0, 1}}};
+            case OpType::Div:
+                return ElementWiseProgram{op->getInputs(),
+                                          {{ElementWiseInstr::Div, 0, 1}}};
+            case OpType::Relu:
+                return ElementWiseProgram{op->getInputs(),
+                                          {{ElementWiseInstr::Relu, 0}}};
+            case OpType::Clip:
+            {
+                auto clip = as<ClipObj>(op);
+                return ElementWiseProgram{
+                    op->getInputs(),
+                    {{ElementWiseInstr::Clip, 0, -1, clip->getMin(),
+                      clip->getMax()}}};
+            }
+            case OpType::FusedElementWise:
+                return ElementWiseProgram{
+                    op->getInputs(), as<FusedElementWiseObj>(op)->getProgram()};
+            default:
+                return std::nullopt;
+            }
+        }
+
+        // The input of `op` to fuse into it, or -1.
+        int fusableInput(const Operator &op)
+        {
+            if (!toProgram(op))
+                return -1;
+            const auto &inputs = op->getInputs();
+            for (size_t i = 0; i < inputs.size(); ++i)
+            {
+                auto source = inputs[i]->getSource();
+                if (!source || !toProgram(source) || convertsType(source))
+                    continue;
+                // the intermediate must be read by `op` only
+                auto targets = inputs[i]->getTargets();
+                if (std::any_of(targets.begin(), targets.end(),
+                                [&](const Operator &t) { return t != op; }))
+                    continue;
+                return i;
+            }
+            return -1;
+        }
+
+        // Run `producer` first, then `consumer` reading its result wherever
+        // it read `intermediate`.
+        ElementWiseProgram fuse(const ElementWiseProgram &consumer,
+                                const ElementWiseProgram &producer,
+                                const Tensor &intermediate)
+        {
+            ElementWiseProgram fused;
+            auto inputReg = [&](const Tensor &tensor)
+            {
+                auto it = std::find(fused.inputs.begin(), fused.inputs.end(),
+                                    tensor);
+                if (it != fused.inputs.end())
+                    return int(it - fused.inputs.begin());
+                fused.inputs.emplace_back(tensor);
+                return int(fused.inputs.size() - 1);
+            };
+            vector<int> producerRegs, consumerRegs;
+            for (auto &input : producer.inputs)
+                producerRegs.emplace_back(inputReg(input));
+            for (auto &input : consumer.inputs)
+                consumerRegs.emplace_back(input == intermediate ? -1
+                                                                : inputReg(input));
+            // registers of instructions follow the inputs
+            int numInputs = fused.inputs.size();
+            for (auto instr : producer.instrs)
+            {
+                instr.a = producerRegs[instr.a];
+                if (!instr.isUnary())
+                    instr.b = producerRegs[instr.b];
+                producerRegs.emplace_back(numInputs + fused.instrs.size());
+                fused.instrs.emplace_back(instr);
+            }
+            int result = producerRegs.back();
+            for (auto &reg : consumerRegs)
+            {
+                if (reg == -1)
+                    reg = result;
+            }
+            for (auto instr : consumer.instrs)
+            {
+                instr.a = consumerRegs[instr.a];
+                if (!instr.isUnary())
+                    instr.b = consumerRegs[instr.b];
+                consumerRegs.emplace_back(numInputs + fused.instrs.size());
+                fused.instrs.emplace_back(instr);
+            }
+            return fused;
+        }
+
+        RewriteRule fuseElementWise()
+        {
+            return {"FuseElementWise",
+                    Pattern().where([](const Operator &op)
+                                    { return fusableInput(op) >= 0; }),
+                    [](GraphObj &g, const OpVec &m)
+                    {
+                        auto &op = m[0];
+                        auto intermediate = op->getInputs(fusableInput(op));
+                        auto producer = intermediate->getSource();
+                        auto fused = fuse(*toProgram(op), *toProgram(producer),
+                                          intermediate);
+                        if (fused.inputs.size() > maxFusedInputs ||
+                            fused.instrs.size() > maxFusedInstrs)
+                            return false;
+                        // the replacement takes over the output first
+                        g.addOpWithOutputs<FusedElementWiseObj>(
+                            fused.inputs, op->getOutput(), fused.instrs);
+                        g.eraseOperator(op);
+                        g.eraseOperator(producer);
+                        return true;
+                    }};
+        }
+
+        // A Cast of a single-use element-wise result becomes the conversion
+        // on the final store of the fused op, see the Cast rules above.
+        RewriteRule fuseCastIntoElementWise()
+        {
+            auto fusable = [](const Operator &op)
+            {
+                auto source = op->getInputs(0)->getSource();
+                return source && toProgram(source) && !convertsType(source) &&
+                       op->getInputs(0)->getTargets().size() == 1 &&
+                       is_convertible(op->getOutput()->getDType());
+            };
+            return {"FuseCastIntoElementWise",
+                    Pattern(OpType::Cast).where(fusable),
+                    [](GraphObj &g, const OpVec &m)
+                    {
+                        auto &cast = m[0];
+                        auto producer = cast->getInputs(0)->getSource();
+                        auto program = *toProgram(producer);
+                        g.addOpWithOutputs<FusedElementWiseObj>(
+                            program.inputs, cast->getOutput(), program.instrs);
+                        g.eraseOperator(cast);
+                        g.eraseOperator(producer);
+                        return true;
+                    }};
+        }
+    } // namespace
+
+    vector<vector<RewriteRule>> getOptimizePhases()
+    {
+        return {
+            {
+                removeIdentityElementWise("RemoveAddZeroA", OpType::Add, 0, 0),
+                removeIdentityElementWise("RemoveAddZeroB", OpType::Add, 1, 0),
+                removeIdentityElementWise("RemoveSubZero", OpType::Sub, 1, 0),
+                removeIdentityElementWise("RemoveMulOneA", OpType::Mul, 0, 1),
+                removeIdentityElementWise("RemoveMulOneB", OpType::Mul, 1, 1),
+                removeIdentityElementWise("RemoveDivOne", OpType::Div, 1, 1),
+                divToMulReciprocal(),
+                mergeClamps(OpType::Relu, OpType::Relu),
+                mergeClamps(OpType::Relu, OpType::Clip),
+                mergeClamps(OpType::Clip, OpType::Relu),
+                mergeClamps(OpType::Clip, OpType::Clip),
+                removeIdentityCast(),
+                removeRoundTripCast(),
+            },
+            {
+                composeTransposes(),
+                removeIdentityTranspose(),
+                sinkTransposeThroughUnary(OpType::Relu),
+                sinkTransposeThroughUnary(OpType::Clip),
+                sinkTransposeThroughUnary(OpType::Cast),
+                sinkTransposeThroughBinary(OpType::Add, 0),
+                sinkTransposeThroughBinary(OpType::Add, 1),
+                sinkTransposeThroughBinary(OpType::Sub, 0),
+                sinkTransposeThroughBinary(OpType::Sub, 1),
+                sinkTransposeThroughBinary(OpType::Mul, 0),
+                sinkTransposeThroughBinary(OpType::Mul, 1),
+                sinkTransposeThroughBinary(OpType::Div, 0),
+                sinkTransposeThroughBinary(OpType::Div, 1),
+                sinkTransposeThroughConcat(),
+                foldCastIntoProducer(OpType::Transpose),
+                foldCastIntoProducer(OpType::Concat),
+                foldCastIntoTranspose(),
+                foldTransposeIntoMatmul(0),
+                foldTransposeIntoMatmul(1),
+                reorderMatmulChain(),
+                fuseMatmulBias(0),
+                fuseMatmulBias(1),
+                fuseMatmulActivation(OpType::Relu),
+                fuseMatmulActivation(OpType::Clip),
+            },
+            {
+                fuseElementWise(),
+                fuseCastIntoElementWise(),
+                fuseSharedInputMatmuls(),
+            },
+        };
+    }
+
+    size_t batchIndependentMatmuls(GraphObj &graph)
+    {
+        // Merging only adds dependencies, so a bucket without a group stays
+        // without one. A merge can reorder the other Matmuls topologically,
+        // so the graph is sorted and bucketed again after each.
+        std::set<MatmulShapeKey> settled;
+        size_t merged = 0;
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            IT_ASSERT(graph.topo_sort());
+            // Buckets keep the topological order of their Matmuls.
+            std::map<MatmulShapeKey, vector<Ref<MatmulObj>>> buckets;
+            for (auto &op : graph.getOperators())
+            {
+                if (op->getOpType() != OpType::MatMul)
+                    continue;
+                auto matmul = as<MatmulObj>(op);
+                if (!isBatchable(matmul))
+                    continue;
+                auto key = matmulShapeKey(matmul);
+                if (!settled.count(key))
+                    buckets[key].emplace_back(matmul);
+            }
+            for (auto &[key, bucket] : buckets)
+            {
+                // In topological order a Matmul can only depend on earlier
+                // ones, so it joins the group unless it is downstream of a
+                // member. One walk over the graph marks everything
+                // downstream of the group, however large it gets. Matmuls
+                // reading the same A are left to FuseSharedInputMatmuls.
+                std::unordered_set<OperatorObj *> downstream;
+                std::unordered_set<TensorObj *> lhs, rhs;
+                vector<Ref<MatmulObj>> group;
+                for (auto &matmul : bucket)
+                {
+                    auto a = matmul->getInputs(0), b = matmul->getInputs(1);
+                    if (downstream.count(matmul.get()) || lhs.count(a.get()) ||
+                        (!isConstantTensor(b) && rhs.count(b.get())))
+                        continue;
+                    group.emplace_back(matmul);
+                    lhs.insert(a.get());
+                    rhs.insert(b.get());
+                    OpVec stack{matmul};
+                    while (!stack.empty())
+                    {
+                        auto current = std::move(stack.back());
+                        stack.pop_back();
+                        for (auto &output : current->getOutputs())
+                        {
+                            for (auto &target : output->getTargets())
+                            {
+                                if (downstream.insert(target.get()).second)
+                                    stack.emplace_back(target);
+                            }
+                        }
+                    }
+                }
+                if (group.size() < 2)
+                {
+                    settled.insert(key);
+                    continue;
+                }
+                batchMatmuls(graph, group);
+                merged += group.size() - 1;
+                changed = true;
+                break;
+            }
+        }
+        return merged;
+    }
+
+} // namespace infini
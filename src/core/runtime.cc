@@ -5,14 +5,30 @@
 #include "core/kernel.h"
 #include <chrono>
 #include <cstring>
+#include <fstream>
 #include <memory>
+#include <sys/mman.h>
 namespace infini
 {
+    // size of a transparent huge page on x86-64 and most aarch64 kernels
+    static constexpr size_t hugePageSize = 2 << 20;
+
     void NativeCpuRuntimeObj::run(const Graph &graph) const
+    {
+        runOperators(graph->getOperators());
+    }
+
+    void NativeCpuRuntimeObj::run(const Graph &graph,
+                                  const TensorVec &outputs) const
+    {
+        runOperators(graph->getProducers(outputs));
+    }
+
+    void NativeCpuRuntimeObj::runOperators(const OpVec &ops) const
     {
         const auto &kernelRegistry = KernelRegistry::getInstance();
 
-        for (auto &op : graph->getOperators())
+        for (auto &op : ops)
         {
             auto kernelAttrs = KernelAttrs{device, op->getOpType().underlying()};
             Kernel *kernel = kernelRegistry.getKernel(kernelAttrs);
@@ -29,8 +45,51 @@ namespace infini
 
     void *NativeCpuRuntimeObj::alloc(size_t size)
     {
-        return calloc((size + sizeof(uint64_t) - 1) / sizeof(uint64_t),
-                      sizeof(uint64_t));
+        size_t align = alignment;
+        bool hugePages = hugePageThreshold > 0 && size >= hugePageThreshold;
+        if (hugePages)
+            align = std::max(align, hugePageSize);
+        // posix_memalign needs a non-zero size that is a multiple of align
+        size = std::max((size + align - 1) / align * align, align);
+        void *ptr = nullptr;
+        IT_ASSERT(posix_memalign(&ptr, align, size) == 0,
+                  "Failed to allocate " + std::to_string(size) + " bytes");
+#ifdef MADV_HUGEPAGE
+        // only a hint, getHugePageBytes reports whether it was taken
+        if (hugePages)
+            madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+        if (zeroFill)
+            std::memset(ptr, 0, size);
+        return ptr;
+    }
+
+    void NativeCpuRuntimeObj::setAlignment(size_t alignment)
+    {
+        IT_ASSERT(alignment >= sizeof(void *) &&
+                      (alignment & (alignment - 1)) == 0,
+                  "Alignment must be a power of two and at least " +
+                      std::to_string(sizeof(void *)));
+        this->alignment = alignment;
+    }
+
+    size_t NativeCpuRuntimeObj::getHugePageBytes(void *ptr)
+    {
+        // Each mapping in /proc/self/smaps starts with a "begin-end ..." line
+        // and reports the bytes backed by huge pages as "AnonHugePages: N kB".
+        std::ifstream smaps("/proc/self/smaps");
+        auto addr = reinterpret_cast<uintptr_t>(ptr);
+        bool inMapping = false;
+        string line;
+        while (std::getline(smaps, line))
+        {
+            unsigned long begin, end;
+            if (sscanf(line.c_str(), "%lx-%lx ", &begin, &end) == 2)
+                inMapping = begin <= addr && addr < end;
+            else if (inMapping && line.rfind("AnonHugePages:", 0) == 0)
+                return std::stoull(line.substr(14)) * 1024;
+        }
+        return 0;
     }
 
 } // namespace infini
@@ -0,0 +1,129 @@
+#include "core/weight_file.h"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace infini
+{
+    WeightFileObj::WeightFileObj(const string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        IT_ASSERT(fd >= 0, "Cannot open weight file " + path);
+        struct stat st;
+        bool statOk = fstat(fd, &st) == 0;
+        length = statOk ? st.st_size : 0;
+        // MAP_PRIVATE + PROT_READ keeps the pages shared with the page cache
+        base = statOk && length >= sizeof(Header)
+                   ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0)
+                   : MAP_FAILED;
+        // the mapping does not need the descriptor to stay open
+        close(fd);
+        IT_ASSERT(statOk, "Cannot stat weight file " + path);
+        IT_ASSERT(length >= sizeof(Header), "Truncated weight file " + path);
+        IT_ASSERT(base != MAP_FAILED, "Cannot map weight file " + path);
+        // the destructor does not run if the checks below throw
+        std::unique_ptr<void, std::function<void(void *)>> mapping(
+            base, [this](void *ptr) { munmap(ptr, length); });
+
+        auto header = static_cast<const Header *>(base);
+        IT_ASSERT(memcmp(header->magic, magic, sizeof(magic)) == 0 &&
+                      header->version == version,
+                  "Not a weight file: " + path);
+        IT_ASSERT(sizeof(Header) + header->count * sizeof(WeightEntry) <=
+                      length,
+                  "Truncated weight file " + path);
+        slots = header->slots;
+        auto entry = reinterpret_cast<const WeightEntry *>(header + 1);
+        for (uint32_t i = 0; i < header->count; ++i, ++entry)
+        {
+            IT_ASSERT(entry->offset <= length &&
+                          entry->bytes <= length - entry->offset,
+                      "Truncated weight file " + path);
+            IT_ASSERT(entry->index >= 0 && (size_t)entry->index < slots &&
+                          entries.count(entry->index) == 0,
+                      "Corrupt weight file " + path);
+            entries[entry->index] = entry;
+        }
+        mapping.release();
+    }
+
+    WeightFileObj::~WeightFileObj() { munmap(base, length); }
+
+    void WeightFileObj::save(const string &path, const TensorVec &weights,
+                             size_t alignment)
+    {
+        IT_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+        auto align = [&](size_t n)
+        { return (n + alignment - 1) / alignment * alignment; };
+
+        vector<WeightEntry> table;
+        TensorVec present;
+        for (size_t i = 0; i < weights.size(); ++i)
+        {
+            auto &tensor = weights[i];
+            if (!tensor)
+                continue;
+            IT_ASSERT(tensor->hasData() && (int)tensor->getRank() <= maxRank);
+            auto &entry = table.emplace_back();
+            memset(&entry, 0, sizeof(entry));
+            entry.index = i;
+            entry.dtype = tensor->getDType().getIndex();
+            entry.rank = tensor->getRank();
+            auto dims = tensor->getDims();
+            std::copy(dims.begin(), dims.end(), entry.dims);
+            entry.bytes = tensor->getBytes();
+            present.emplace_back(tensor);
+        }
+        Header header;
+        memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.count = table.size();
+        header.slots = weights.size();
+        header.alignment = alignment;
+        size_t offset =
+            align(sizeof(Header) + table.size() * sizeof(WeightEntry));
+        for (auto &entry : table)
+        {
+            entry.offset = offset;
+            offset = align(offset + entry.bytes);
+        }
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        IT_ASSERT(file.good(), "Cannot create weight file " + path);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(table.data()),
+                   table.size() * sizeof(WeightEntry));
+        for (size_t i = 0; i < table.size(); ++i)
+        {
+            file.seekp(table[i].offset);
+            file.write(present[i]->getRawDataPtr<const char *>(),
+                       table[i].bytes);
+        }
+        // pad the file to the end of the last aligned block
+        file.seekp(offset > 0 ? offset - 1 : 0);
+        file.put(0);
+        IT_ASSERT(file.good(), "Failed to write weight file " + path);
+    }
+
+    void *WeightFileObj::getData(size_t index, const Tensor &tensor) const
+    {
+        auto it = entries.find(index);
+        if (it == entries.end())
+            return nullptr;
+        auto entry = it->second;
+        auto dims = tensor->getDims();
+        IT_ASSERT(entry->dtype == tensor->getDType().getIndex() &&
+                      entry->rank == (int)dims.size() &&
+                      std::equal(dims.begin(), dims.end(), entry->dims) &&
+                      entry->bytes == tensor->getBytes(),
+                  "Weight " + std::to_string(index) +
+                      " does not match the weight file");
+        return static_cast<char *>(base) + entry->offset;
+    }
+
+} // namespace infini
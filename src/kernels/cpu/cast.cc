@@ -0,0 +1,37 @@
+#include "operators/unary.h"
+#include "core/kernel.h"
+#include "utils/data_convert.h"
+
+namespace infini
+{
+    class NaiveCast : public CpuKernelWithoutConfig
+    {
+        // Element i of the output is written right after element i of the
+        // input is read, which is safe in place when the sizes match.
+        bool supportsInPlace(const Operator &op, size_t index) const override
+        {
+            return op->getDType().getSize() == op->getOutDType().getSize();
+        }
+
+        void compute(const Operator &_op,
+                     const RuntimeObj *context) const override
+        {
+            auto op = as<CastObj>(_op);
+            auto input = op->getInputs(0), output = op->getOutput();
+            IT_ASSERT(output->getDType() == op->getOutputDataType());
+            dispatch_convertible(input->getDType(), [&](auto in)
+            {
+                using TIn = decltype(in);
+                dispatch_convertible(output->getDType(), [&](auto out)
+                {
+                    using TOut = decltype(out);
+                    convert_data(input->getRawDataPtr<TIn *>(),
+                                 output->getRawDataPtr<TOut *>(),
+                                 output->size());
+                });
+            });
+        }
+    };
+
+    REGISTER_KERNEL(Device::CPU, OpType::Cast, NaiveCast, "castNaive_CPU");
+}; // namespace infini
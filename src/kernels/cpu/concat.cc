@@ -1,57 +1,74 @@
 #include "operators/concat.h"
 #include "core/kernel.h"
+#include "utils/data_convert.h"
 
 namespace infini {
 
 class NaiveConcat : public CpuKernelWithoutConfig {
-    template <typename T>
+    template <typename TIn, typename TOut = TIn>
     void doCompute(const Operator &_op, const RuntimeObj *context) const {
         auto op = as<ConcatObj>(_op);
         auto inputs = op->getInputs(), outputs = op->getOutputs();
         auto dim = op->getDim();
         auto output = outputs[0];
-        std::vector<Shape> iDims;
-        for (auto input : inputs)
-            iDims.emplace_back(input->getDims());
         const auto &outDim = output->getDims();
+        // The output is `outer` rows of `blockOffset` elements each, and every
+        // input owns one contiguous range of each row.
         size_t blockOffsetInner = 1;
         for (size_t i = outDim.size() - 1; i > (size_t)dim; --i)
             blockOffsetInner *= outDim[i];
         size_t blockOffset = outDim[dim] * blockOffsetInner;
-        for (size_t i = 0; i < inputs.size(); ++i) {
-            auto input = inputs[i];
-            auto dimOffset = 0;
-            auto iDim = iDims[i];
-            for (size_t j = 0; j < i; ++j)
-                dimOffset += iDims[j][dim];
-            size_t localBlockOffset = 1;
-            for (size_t i = iDim.size() - 1;
-                 i >= (size_t)dim && i != (size_t)-1; --i)
-                localBlockOffset *= iDim[i];
-            auto innerOffset = blockOffsetInner * dimOffset;
-            auto inSize = input->size();
-            auto inPtr = input->getRawDataPtr<T *>(),
-                 outPtr = output->getRawDataPtr<T *>();
+        size_t outer = output->size() / blockOffset;
+        auto outPtr = output->getRawDataPtr<TOut *>();
+        size_t innerOffset = 0;
+        for (auto &input : inputs) {
+            size_t localBlockOffset = input->getDims()[dim] * blockOffsetInner;
+            auto inPtr = input->getRawDataPtr<TIn *>();
+            if constexpr (std::is_same_v<TIn, TOut>) {
+                // The memory planner may have made the producer write
+                // straight into the output, see GraphObj::dataMalloc.
+                if (outer == 1 && inPtr == outPtr + innerOffset) {
+                    innerOffset += localBlockOffset;
+                    continue;
+                }
+            }
 #pragma omp parallel for
-            for (size_t iOffset = 0; iOffset < inSize; ++iOffset) {
-                auto oOffset = iOffset % localBlockOffset + innerOffset +
-                               iOffset / localBlockOffset * blockOffset;
-                outPtr[oOffset] = inPtr[iOffset];
+            for (size_t o = 0; o < outer; ++o) {
+                auto dst = outPtr + o * blockOffset + innerOffset;
+                auto src = inPtr + o * localBlockOffset;
+                // a Cast folded into the concat converts while copying
+                if constexpr (std::is_same_v<TIn, TOut>)
+                    std::memcpy(dst, src, localBlockOffset * sizeof(TIn));
+                else
+                    convert_data(src, dst, localBlockOffset);
             }
+            innerOffset += localBlockOffset;
         }
     }
 
     void compute(const Operator &_op,
                  const RuntimeObj *context) const override {
-#define CASE(N)                                                                \
-    case N:                                                                    \
-        doCompute<DT<N>::t>(_op, context)
-
-        int dataTypeIdx = _op->getDType().getIndex();
-        switch (dataTypeIdx) {
-            CASE(1); // DataType::Float32
+        if (!(_op->getDType() == _op->getOutDType())) {
+            dispatch_convertible(_op->getDType(), [&](auto in) {
+                dispatch_convertible(_op->getOutDType(), [&](auto out) {
+                    doCompute<decltype(in), decltype(out)>(_op, context);
+                });
+            });
+            return;
+        }
+        // only copies elements, so any type of the same size will do
+        switch (_op->getDType().getSize()) {
+        case 1:
+            doCompute<uint8_t>(_op, context);
+            break;
+        case 2:
+            doCompute<uint16_t>(_op, context);
+            break;
+        case 4:
+            doCompute<uint32_t>(_op, context);
             break;
-            CASE(12); // DataType::UInt32
+        case 8:
+            doCompute<uint64_t>(_op, context);
             break;
         default:
             IT_TODO_HALT();
@@ -92,6 +92,13 @@ namespace infini
             }
         }
 
+        // An input that is not broadcast is read at the position of the output
+        // element being written, so it may be overwritten in place.
+        bool supportsInPlace(const Operator &op, size_t index) const override
+        {
+            return op->getInputs(index)->getDims() == op->getOutput()->getDims();
+        }
+
         void compute(const Operator &_op,
                      const RuntimeObj *context) const override
         {
@@ -0,0 +1,210 @@
+#include "operators/fused_element_wise.h"
+#include "core/kernel.h"
+#include "utils/data_convert.h"
+
+namespace infini
+{
+    class NativeFusedElementWise : public CpuKernelWithoutConfig
+    {
+        // Elements evaluated per instruction, so that the registers of a
+        // program stay in L1.
+        static constexpr size_t blockSize = 256;
+
+        template <typename T>
+        static void runInstr(const ElementWiseInstr &instr, const T *a,
+                             const T *b, T *c, size_t n)
+        {
+            switch (instr.code)
+            {
+            case ElementWiseInstr::Add:
+                for (size_t i = 0; i < n; ++i)
+                    c[i] = a[i] + b[i];
+                break;
+            case ElementWiseInstr::Sub:
+                for (size_t i = 0; i < n; ++i)
+                    c[i] = a[i] - b[i];
+                break;
+            case ElementWiseInstr::Mul:
+                for (size_t i = 0; i < n; ++i)
+                    c[i] = a[i] * b[i];
+                break;
+            case ElementWiseInstr::Div:
+                for (size_t i = 0; i < n; ++i)
+                    c[i] = (T)(a[i] / b[i]);
+                break;
+            case ElementWiseInstr::Relu:
+                for (size_t i = 0; i < n; ++i)
+                    c[i] = std::max(T(0), a[i]);
+                break;
+            case ElementWiseInstr::Clip:
+            {
+                auto minValue = instr.min, maxValue = instr.max;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    auto val = a[i];
+                    c[i] = (minValue && val < *minValue)   ? *minValue
+                           : (maxValue && val > *maxValue) ? *maxValue
+                                                           : val;
+                }
+                break;
+            }
+            default:
+                IT_TODO_HALT();
+            }
+        }
+
+        // Computes in T, the type of the inputs, and writes TOut.
+        template <typename T, typename TOut>
+        void doCompute(const Operator &_op, const RuntimeObj *context) const
+        {
+            constexpr bool converts = !std::is_same_v<T, TOut>;
+            auto op = as<FusedElementWiseObj>(_op);
+            const auto &program = op->getProgram();
+            const size_t numInputs = op->numInputs();
+            TOut *outptr = op->getOutput()->getRawDataPtr<TOut *>();
+            auto outDims = op->getOutput()->getDims();
+            const int rank = outDims.size();
+
+            // The stride of every input along each output dimension, 0 where
+            // the input is broadcast.
+            vector<vector<size_t>> strides(numInputs, vector<size_t>(rank, 0));
+            for (size_t i = 0; i < numInputs; ++i)
+            {
+                auto dims = op->getInputs(i)->getDims();
+                size_t stride = 1;
+                for (int d = rank - 1, e = (int)dims.size() - 1; e >= 0; --d, --e)
+                {
+                    if (dims[e] != 1)
+                        strides[i][d] = stride;
+                    stride *= dims[e];
+                }
+            }
+            // Merge adjacent dimensions that are contiguous in every input,
+            // so that the innermost loop runs as long as possible. Dimensions
+            // of size 1 are dropped.
+            Shape loopDims;
+            vector<vector<size_t>> loopStrides(numInputs);
+            for (int d = rank - 1; d >= 0; --d)
+            {
+                if (outDims[d] == 1)
+                    continue;
+                bool merge = !loopDims.empty();
+                for (size_t i = 0; merge && i < numInputs; ++i)
+                    merge = strides[i][d] ==
+                            loopStrides[i].back() * loopDims.back();
+                if (merge)
+                {
+                    loopDims.back() *= outDims[d];
+                    continue;
+                }
+                loopDims.emplace_back(outDims[d]);
+                for (size_t i = 0; i < numInputs; ++i)
+                    loopStrides[i].emplace_back(strides[i][d]);
+            }
+            if (loopDims.empty())
+            {
+                loopDims.emplace_back(1);
+                for (size_t i = 0; i < numInputs; ++i)
+                    loopStrides[i].emplace_back(0);
+            }
+            // loopDims[0] is the innermost dimension, with stride 0 or 1
+            const size_t inner = loopDims[0];
+            const size_t rows = op->getOutput()->size() / inner;
+
+            vector<const T *> inptrs(numInputs);
+            for (size_t i = 0; i < numInputs; ++i)
+                inptrs[i] = op->getInputs(i)->getRawDataPtr<T *>();
+            vector<T> buffers(op->numRegisters() * blockSize);
+            vector<const T *> regs(op->numRegisters());
+            vector<size_t> offsets(numInputs, 0);
+            Shape index(loopDims.size(), 0);
+            for (size_t row = 0; row < rows; ++row)
+            {
+                for (size_t begin = 0; begin < inner; begin += blockSize)
+                {
+                    size_t n = std::min(blockSize, inner - begin);
+                    for (size_t i = 0; i < numInputs; ++i)
+                    {
+                        if (loopStrides[i][0] != 0)
+                        {
+                            regs[i] = inptrs[i] + offsets[i] + begin;
+                            continue;
+                        }
+                        T *buffer = buffers.data() + i * blockSize;
+                        std::fill(buffer, buffer + n, inptrs[i][offsets[i]]);
+                        regs[i] = buffer;
+                    }
+                    TOut *out = outptr + row * inner + begin;
+                    for (size_t k = 0; k < program.size(); ++k)
+                    {
+                        size_t reg = numInputs + k;
+                        T *dst = buffers.data() + reg * blockSize;
+                        if constexpr (!converts)
+                        {
+                            if (k + 1 == program.size())
+                                dst = out;
+                        }
+                        const auto &instr = program[k];
+                        runInstr(instr, regs[instr.a],
+                                 instr.isUnary() ? nullptr : regs[instr.b], dst,
+                                 n);
+                        regs[reg] = dst;
+                    }
+                    if constexpr (converts)
+                        convert_data(regs.back(), out, n);
+                }
+                // next row: advance the outer index and the input offsets
+                for (size_t d = 1; d < loopDims.size(); ++d)
+                {
+                    for (size_t i = 0; i < numInputs; ++i)
+                        offsets[i] += loopStrides[i][d];
+                    if (++index[d] < loopDims[d])
+                        break;
+                    for (size_t i = 0; i < numInputs; ++i)
+                        offsets[i] -= loopStrides[i][d] * loopDims[d];
+                    index[d] = 0;
+                }
+            }
+        }
+
+        // Every register is computed block by block from the same positions
+        // of the inputs before the output block is written, so an input of
+        // the output shape may be overwritten in place.
+        bool supportsInPlace(const Operator &op, size_t index) const override
+        {
+            return op->getInputs(index)->getDims() == op->getOutput()->getDims();
+        }
+
+        template <typename T>
+        void dispatchOutput(const Operator &_op, const RuntimeObj *context) const
+        {
+            if (_op->getOutDType() == _op->getDType())
+                return doCompute<T, T>(_op, context);
+            // a Cast fused into the program converts the result
+            dispatch_convertible(_op->getOutDType(), [&](auto out)
+                                 { doCompute<T, decltype(out)>(_op, context); });
+        }
+
+        void compute(const Operator &_op,
+                     const RuntimeObj *context) const override
+        {
+#define CASE(N) \
+    case N:     \
+        dispatchOutput<DT<N>::t>(_op, context)
+
+            int dataTypeIdx = _op->getDType().getIndex();
+            switch (dataTypeIdx)
+            {
+                CASE(1); // DataType::Float32
+                break;
+                CASE(12); // DataType::UInt32
+                break;
+            default:
+                IT_TODO_HALT();
+            }
+        }
+    };
+
+    REGISTER_KERNEL(Device::CPU, OpType::FusedElementWise,
+                    NativeFusedElementWise, "fusedElementWiseNaive_CPU");
+}; // namespace infini
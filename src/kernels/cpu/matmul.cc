@@ -0,0 +1,575 @@
+#include "operators/matmul.h"
+#include "core/kernel.h"
+#include "utils/operator_utils.h"
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace infini
+{
+    namespace
+    {
+        // ===== 分块参数 =====
+        // BLIS-style blocking: a KC x NC panel of packed B stays in L3, an
+        // MC x KC block of packed A in L2, and the KC x NR micro-panel of B
+        // in L1 while the microkernel keeps an MR x NR tile of C in
+        // registers. MC is a multiple of every MR below, NC of every NR.
+        constexpr size_t MC = 96, KC = 192, NC = 2048;
+        constexpr size_t MAX_TILE = 6 * 32;
+
+        // ===== GEMV 参数 =====
+        // Matmuls whose M or N is at most SKINNY_MAX are a handful of GEMVs
+        // and bound by the bandwidth of reading the other operand, so they
+        // skip packing. Columns are split into chunks of COL_CHUNK, and K
+        // into slices of at least MIN_K_SLICE when the chunks alone leave
+        // threads idle.
+        constexpr size_t SKINNY_MAX = 4, COL_CHUNK = 512, MIN_K_SLICE = 1024;
+
+        // Computes the MR x NR tile a * b over kc packed columns, and stores
+        // it to c with row stride ldc, adding to what c holds if accumulate.
+        template <typename T>
+        using MicroKernel = void (*)(size_t kc, const T *a, const T *b, T *c,
+                                     size_t ldc, bool accumulate);
+
+        template <typename T>
+        struct GemmConfig
+        {
+            size_t mr, nr;
+            MicroKernel<T> kernel;
+        };
+
+        // ===== 微内核 =====
+        template <typename T, size_t MR, size_t NR>
+        void kernelGeneric(size_t kc, const T *a, const T *b, T *c,
+                           size_t ldc, bool accumulate)
+        {
+            T acc[MR][NR] = {};
+            for (size_t p = 0; p < kc; ++p, a += MR, b += NR)
+                for (size_t i = 0; i < MR; ++i)
+                    for (size_t j = 0; j < NR; ++j)
+                        acc[i][j] += a[i] * b[j];
+            for (size_t i = 0; i < MR; ++i)
+                for (size_t j = 0; j < NR; ++j)
+                    c[i * ldc + j] =
+                        accumulate ? c[i * ldc + j] + acc[i][j] : acc[i][j];
+        }
+
+#if defined(__x86_64__)
+        // 6 x 16: twelve ymm accumulators, two for the row of B and one for
+        // the broadcast element of A. The tile of C is prefetched so its
+        // load or store at the end does not stall on memory.
+        __attribute__((target("avx2,fma"))) void
+        kernelAvx2(size_t kc, const float *a, const float *b, float *c,
+                   size_t ldc, bool accumulate)
+        {
+            __m256 acc[6][2];
+            for (int i = 0; i < 6; ++i)
+            {
+                acc[i][0] = acc[i][1] = _mm256_setzero_ps();
+                _mm_prefetch(reinterpret_cast<const char *>(c + i * ldc),
+                             _MM_HINT_T0);
+            }
+            for (size_t p = 0; p < kc; ++p, a += 6, b += 16)
+            {
+                __m256 b0 = _mm256_loadu_ps(b), b1 = _mm256_loadu_ps(b + 8);
+#pragma GCC unroll 6
+                for (int i = 0; i < 6; ++i)
+                {
+                    __m256 ai = _mm256_broadcast_ss(a + i);
+                    acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+                    acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+                }
+            }
+            for (int i = 0; i < 6; ++i, c += ldc)
+            {
+                if (accumulate)
+                {
+                    acc[i][0] = _mm256_add_ps(acc[i][0], _mm256_loadu_ps(c));
+                    acc[i][1] =
+                        _mm256_add_ps(acc[i][1], _mm256_loadu_ps(c + 8));
+                }
+                _mm256_storeu_ps(c, acc[i][0]);
+                _mm256_storeu_ps(c + 8, acc[i][1]);
+            }
+        }
+
+        // 6 x 32, the same register layout in zmm.
+        __attribute__((target("avx512f"))) void
+        kernelAvx512(size_t kc, const float *a, const float *b, float *c,
+                     size_t ldc, bool accumulate)
+        {
+            __m512 acc[6][2];
+            for (int i = 0; i < 6; ++i)
+            {
+                acc[i][0] = acc[i][1] = _mm512_setzero_ps();
+                _mm_prefetch(reinterpret_cast<const char *>(c + i * ldc),
+                             _MM_HINT_T0);
+                _mm_prefetch(reinterpret_cast<const char *>(c + i * ldc + 16),
+                             _MM_HINT_T0);
+            }
+            for (size_t p = 0; p < kc; ++p, a += 6, b += 32)
+            {
+                __m512 b0 = _mm512_loadu_ps(b), b1 = _mm512_loadu_ps(b + 16);
+#pragma GCC unroll 6
+                for (int i = 0; i < 6; ++i)
+                {
+                    __m512 ai = _mm512_set1_ps(a[i]);
+                    acc[i][0] = _mm512_fmadd_ps(ai, b0, acc[i][0]);
+                    acc[i][1] = _mm512_fmadd_ps(ai, b1, acc[i][1]);
+                }
+            }
+            for (int i = 0; i < 6; ++i, c += ldc)
+            {
+                if (accumulate)
+                {
+                    acc[i][0] = _mm512_add_ps(acc[i][0], _mm512_loadu_ps(c));
+                    acc[i][1] =
+                        _mm512_add_ps(acc[i][1], _mm512_loadu_ps(c + 16));
+                }
+                _mm512_storeu_ps(c, acc[i][0]);
+                _mm512_storeu_ps(c + 16, acc[i][1]);
+            }
+        }
+#endif
+
+        template <typename T>
+        GemmConfig<T> selectConfig()
+        {
+            return {4, 8, kernelGeneric<T, 4, 8>};
+        }
+
+        // The widest microkernel the CPU runs. INFINI_CPU_ISA=avx2 or
+        // INFINI_CPU_ISA=generic caps the choice, e.g. to test the fallbacks.
+        template <>
+        GemmConfig<float> selectConfig<float>()
+        {
+            const char *cap = std::getenv("INFINI_CPU_ISA");
+            int level = !cap                           ? 2
+                        : std::strcmp(cap, "avx2") == 0 ? 1
+                        : std::strcmp(cap, "generic") == 0 ? 0
+                                                            : 2;
+#if defined(__x86_64__)
+            if (level >= 2 && __builtin_cpu_supports("avx512f"))
+                return {6, 32, kernelAvx512};
+            if (level >= 1 && __builtin_cpu_supports("avx2") &&
+                __builtin_cpu_supports("fma"))
+                return {6, 16, kernelAvx2};
+#endif
+            (void)level;
+            return {4, 16, kernelGeneric<float, 4, 16>};
+        }
+
+        // ===== 打包 =====
+        // Packs the mc x kc block of A, element (i, p) at a[i * rs + p * cs],
+        // into micro-panels of mr rows stored column by column, so the
+        // microkernel reads A contiguously. The last panel is zero-padded.
+        template <typename T>
+        void packA(T *dst, const T *a, size_t rs, size_t cs, size_t mc,
+                   size_t kc, size_t mr, bool parallel)
+        {
+            const size_t panels = (mc + mr - 1) / mr;
+#pragma omp parallel for if (parallel)
+            for (size_t panel = 0; panel < panels; ++panel)
+            {
+                const size_t ir = panel * mr, rows = std::min(mr, mc - ir);
+                T *out = dst + panel * mr * kc;
+                for (size_t p = 0; p < kc; ++p, out += mr)
+                {
+                    for (size_t i = 0; i < rows; ++i)
+                        out[i] = a[(ir + i) * rs + p * cs];
+                    std::fill(out + rows, out + mr, T(0));
+                }
+            }
+        }
+
+        // The same for the kc x nc panel of B, element (p, j) at
+        // b[p * rs + j * cs], in micro-panels of nr columns stored row by row.
+        template <typename T>
+        void packB(T *dst, const T *b, size_t rs, size_t cs, size_t kc,
+                   size_t nc, size_t nr, bool parallel)
+        {
+            const size_t panels = (nc + nr - 1) / nr;
+#pragma omp parallel for if (parallel)
+            for (size_t panel = 0; panel < panels; ++panel)
+            {
+                const size_t jr = panel * nr, cols = std::min(nr, nc - jr);
+                T *out = dst + panel * nr * kc;
+                for (size_t p = 0; p < kc; ++p, out += nr)
+                {
+                    const T *row = b + p * rs + jr * cs;
+                    for (size_t j = 0; j < cols; ++j)
+                        out[j] = row[j * cs];
+                    std::fill(out + cols, out + nr, T(0));
+                }
+            }
+        }
+
+        // A buffer of n elements in storage that starts on a cache line, so
+        // the vector loads of packed data never straddle two lines.
+        template <typename T>
+        T *cacheAligned(vector<T> &storage, size_t n)
+        {
+            constexpr size_t line = 64;
+            storage.resize(n + line / sizeof(T));
+            void *ptr = storage.data();
+            size_t space = storage.size() * sizeof(T);
+            return static_cast<T *>(std::align(line, n * sizeof(T), ptr, space));
+        }
+
+        // ===== GEMV =====
+        // out(r, j) = sum_p X(r, p) * Y(p, j) for R <= SKINNY_MAX rows, with
+        // X(r, p) at x[r * rsX + p * csX] and the like for Y and out. Y is
+        // contiguous along j (streamed row by row, as axpys) or along p
+        // (as dot products). Every (K slice, column chunk) pair is a task;
+        // the partial sums of the K slices are added up at the end.
+        template <typename T>
+        void skinny(const T *x, size_t rsX, size_t csX, const T *y, size_t rsY,
+                    size_t csY, T *out, size_t rsOut, size_t csOut, size_t R,
+                    size_t L, size_t K, int threads)
+        {
+            vector<T> rowsX(R * K);
+            for (size_t r = 0; r < R; ++r)
+                for (size_t p = 0; p < K; ++p)
+                    rowsX[r * K + p] = x[r * rsX + p * csX];
+
+            const size_t chunks = (L + COL_CHUNK - 1) / COL_CHUNK;
+            size_t slices = 1;
+            if (chunks < size_t(threads))
+                slices = std::max<size_t>(
+                    1, std::min(threads / chunks, K / MIN_K_SLICE));
+            const size_t sliceK = (K + slices - 1) / slices;
+            vector<T> partial(slices * R * L);
+
+#pragma omp parallel for collapse(2) if (threads > 1 && slices * chunks > 1)
+            for (size_t slice = 0; slice < slices; ++slice)
+            {
+                for (size_t chunk = 0; chunk < chunks; ++chunk)
+                {
+                    const size_t p0 = slice * sliceK;
+                    const size_t p1 = std::min(K, p0 + sliceK);
+                    const size_t j0 = chunk * COL_CHUNK;
+                    const size_t j1 = std::min(L, j0 + COL_CHUNK);
+                    T *acc = partial.data() + slice * R * L;
+                    if (csY == 1)
+                    {
+                        // four rows of Y per pass, so each pass over the
+                        // accumulators does four FMAs per element
+                        size_t p = p0;
+                        for (; p + 4 <= p1; p += 4)
+                        {
+                            const T *y0 = y + p * rsY, *y1 = y0 + rsY;
+                            const T *y2 = y1 + rsY, *y3 = y2 + rsY;
+                            for (size_t r = 0; r < R; ++r)
+                            {
+                                const T *v = rowsX.data() + r * K + p;
+                                const T v0 = v[0], v1 = v[1], v2 = v[2],
+                                        v3 = v[3];
+                                T *accRow = acc + r * L;
+#pragma omp simd
+                                for (size_t j = j0; j < j1; ++j)
+                                    accRow[j] += v0 * y0[j] + v1 * y1[j] +
+                                                 v2 * y2[j] + v3 * y3[j];
+                            }
+                        }
+                        for (; p < p1; ++p)
+                        {
+                            const T *row = y + p * rsY;
+                            for (size_t r = 0; r < R; ++r)
+                            {
+                                const T v = rowsX[r * K + p];
+                                T *accRow = acc + r * L;
+#pragma omp simd
+                                for (size_t j = j0; j < j1; ++j)
+                                    accRow[j] += v * row[j];
+                            }
+                        }
+                    }
+                    else
+                    {
+                        for (size_t j = j0; j < j1; ++j)
+                        {
+                            const T *col = y + j * csY;
+                            for (size_t r = 0; r < R; ++r)
+                            {
+                                const T *row = rowsX.data() + r * K;
+                                T sum = 0;
+#pragma omp simd reduction(+ : sum)
+                                for (size_t p = p0; p < p1; ++p)
+                                    sum += row[p] * col[p];
+                                acc[r * L + j] = sum;
+                            }
+                        }
+                    }
+                }
+            }
+
+            for (size_t r = 0; r < R; ++r)
+                for (size_t j = 0; j < L; ++j)
+                {
+                    T sum = partial[r * L + j];
+                    for (size_t slice = 1; slice < slices; ++slice)
+                        sum += partial[(slice * R + r) * L + j];
+                    out[r * rsOut + j * csOut] = sum;
+                }
+        }
+    } // namespace
+
+    class CpuMatmul : public CpuKernelWithoutConfig
+    {
+        // Adds the bias to a row of C and applies the activation, while the
+        // row is still in L1.
+        template <typename T>
+        static void epilogue(const MatmulObj &op, T *row, const T *biasRow,
+                             size_t biasStride, size_t n)
+        {
+            if (biasRow)
+            {
+                for (size_t j = 0; j < n; ++j)
+                    row[j] += biasRow[j * biasStride];
+            }
+            switch (op.getAct())
+            {
+            case ActType::None:
+                break;
+            case ActType::Relu:
+                for (size_t j = 0; j < n; ++j)
+                    row[j] = std::max(T(0), row[j]);
+                break;
+            case ActType::Clip:
+            {
+                auto minValue = op.getMin(), maxValue = op.getMax();
+                for (size_t j = 0; j < n; ++j)
+                {
+                    auto val = row[j];
+                    row[j] = (minValue && val < *minValue)   ? *minValue
+                             : (maxValue && val > *maxValue) ? *maxValue
+                                                             : val;
+                }
+                break;
+            }
+            default:
+                IT_TODO_HALT();
+            }
+        }
+
+        // The bias as a (biasM x biasN) matrix, broadcast to C.
+        template <typename T>
+        struct Bias
+        {
+            const T *data = nullptr;
+            size_t m = 1, n = 1;
+
+            // the bias of row i from column j on, and its column stride
+            const T *at(size_t i, size_t j) const
+            {
+                return data ? data + (m == 1 ? 0 : i) * n + (n == 1 ? 0 : j)
+                            : nullptr;
+            }
+            size_t stride() const { return n == 1 ? 0 : 1; }
+        };
+
+        // C = op(A) * op(B) for one m x n matrix of C. Loops jc/pc/ic/jr/ir
+        // as in BLIS; the (ic, jr) pairs of a KC step are independent and
+        // run in parallel, each thread reusing its block of A from L2
+        // across consecutive micro-panels of B.
+        template <typename T>
+        static void gemm(const GemmConfig<T> &cfg, const MatmulObj &op,
+                         const T *A, const T *B, T *C, size_t m, size_t n,
+                         size_t k, const Bias<T> &bias, bool parallel)
+        {
+            const bool transA = op.getTransA(), transB = op.getTransB();
+            const size_t rsA = transA ? 1 : k, csA = transA ? m : 1;
+            const size_t rsB = transB ? 1 : n, csB = transB ? k : 1;
+            const size_t mr = cfg.mr, nr = cfg.nr;
+            const size_t kcMax = std::min(k, KC), ncMax = std::min(n, NC);
+            vector<T> storageA, storageB;
+            T *packedA = cacheAligned(storageA, (m + mr - 1) / mr * mr * kcMax);
+            T *packedB =
+                cacheAligned(storageB, (ncMax + nr - 1) / nr * nr * kcMax);
+
+            if (k == 0)
+                std::fill(C, C + m * n, T(0));
+            for (size_t jc = 0; jc < n; jc += NC)
+            {
+                const size_t nc = std::min(NC, n - jc);
+                for (size_t pc = 0; pc < k; pc += KC)
+                {
+                    const size_t kc = std::min(KC, k - pc);
+                    const bool first = pc == 0, last = pc + kc == k;
+                    packB(packedB, B + pc * rsB + jc * csB, rsB, csB,
+                          kc, nc, nr, parallel);
+                    packA(packedA, A + pc * csA, rsA, csA, m, kc, mr,
+                          parallel);
+                    const size_t mBlocks = (m + MC - 1) / MC;
+                    const size_t nPanels = (nc + nr - 1) / nr;
+#pragma omp parallel for collapse(2) if (parallel)
+                    for (size_t ic = 0; ic < mBlocks; ++ic)
+                    {
+                        for (size_t panel = 0; panel < nPanels; ++panel)
+                        {
+                            const size_t jr = panel * nr;
+                            const size_t cols = std::min(nr, nc - jr);
+                            const T *b = packedB + jr * kc;
+                            const size_t iEnd = std::min(m, (ic + 1) * MC);
+                            for (size_t ir = ic * MC; ir < iEnd; ir += mr)
+                            {
+                                const size_t rows = std::min(mr, m - ir);
+                                const T *a = packedA + ir * kc;
+                                T *c = C + ir * n + jc + jr;
+                                if (rows == mr && cols == nr)
+                                    cfg.kernel(kc, a, b, c, n, !first);
+                                else
+                                {
+                                    // edge tile: compute in full, store the
+                                    // part inside C
+                                    T tile[MAX_TILE];
+                                    cfg.kernel(kc, a, b, tile, nr, false);
+                                    for (size_t i = 0; i < rows; ++i)
+                                        for (size_t j = 0; j < cols; ++j)
+                                            c[i * n + j] =
+                                                first ? tile[i * nr + j]
+                                                      : c[i * n + j] +
+                                                            tile[i * nr + j];
+                                }
+                                if (last && op.hasEpilogue())
+                                {
+                                    for (size_t i = 0; i < rows; ++i)
+                                        epilogue(op, c + i * n,
+                                                 bias.at(ir + i, jc + jr),
+                                                 bias.stride(), cols);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            if (k == 0 && op.hasEpilogue())
+            {
+                for (size_t i = 0; i < m; ++i)
+                    epilogue(op, C + i * n, bias.at(i, 0), bias.stride(), n);
+            }
+        }
+
+        // C = op(A) * op(B) for one matrix of C with M or N at most
+        // SKINNY_MAX. Small M reads B once as Y; small N is the same product
+        // transposed, C^T = op(B)^T * op(A)^T, reading A once.
+        template <typename T>
+        static void gemv(const MatmulObj &op, const T *A, const T *B, T *C,
+                         size_t m, size_t n, size_t k, const Bias<T> &bias,
+                         int threads)
+        {
+            const bool transA = op.getTransA(), transB = op.getTransB();
+            const size_t rsA = transA ? 1 : k, csA = transA ? m : 1;
+            const size_t rsB = transB ? 1 : n, csB = transB ? k : 1;
+            if (m <= n)
+                skinny(A, rsA, csA, B, rsB, csB, C, n, 1, m, n, k, threads);
+            else
+                skinny(B, csB, rsB, A, csA, rsA, C, 1, n, n, m, k, threads);
+            if (op.hasEpilogue())
+            {
+                for (size_t i = 0; i < m; ++i)
+                    epilogue(op, C + i * n, bias.at(i, 0), bias.stride(), n);
+            }
+        }
+
+        template <typename T>
+        void doCompute(const Operator &_op, const RuntimeObj *context) const
+        {
+            auto op = as<MatmulObj>(_op);
+            const T *A = op->getInputs(0)->getRawDataPtr<T *>();
+            const T *B = op->getInputs(1)->getRawDataPtr<T *>();
+            T *C = op->getOutput()->getRawDataPtr<T *>();
+            auto shapeA = op->getInputs(0)->getDims();
+            auto shapeB = op->getInputs(1)->getDims();
+            auto shapeC = op->getOutput()->getDims();
+            const size_t m = op->getM(), n = op->getN(), k = op->getK();
+
+            // batch offsets of A and B, broadcast like element-wise inputs
+            Shape batchC(shapeC.begin(), shapeC.end() - 2);
+            auto batchStrides = [&](const Shape &shape, size_t matrixSize)
+            {
+                Shape batch(batchC.size(), 1), stride(batchC.size(), 0);
+                size_t p = matrixSize;
+                for (size_t i = 0; i + 2 < shape.size(); ++i)
+                    batch[batchC.size() - (shape.size() - 2) + i] = shape[i];
+                for (size_t i = batch.size(); i > 0; --i)
+                {
+                    stride[i - 1] = p;
+                    p *= batch[i - 1];
+                }
+                return std::make_pair(batch, stride);
+            };
+            auto [batchA, strideA] = batchStrides(shapeA, m * k);
+            auto [batchB, strideB] = batchStrides(shapeB, k * n);
+            size_t numBatches = 1;
+            for (auto d : batchC)
+                numBatches *= d;
+
+            Bias<T> bias;
+            if (auto t = op->getBias())
+            {
+                bias.data = t->getRawDataPtr<T *>();
+                auto shape = t->getDims();
+                if (shape.size() >= 1)
+                    bias.n = shape[shape.size() - 1];
+                if (shape.size() >= 2)
+                    bias.m = shape[shape.size() - 2];
+            }
+
+            // Enough batches to keep every thread busy are split between the
+            // threads whole; otherwise each GEMM is split inside.
+            int threads = 1;
+#ifdef _OPENMP
+            threads = omp_get_max_threads();
+#endif
+            const bool parallelBatches =
+                numBatches > 1 && numBatches >= size_t(threads);
+            const auto cfg = selectConfig<T>();
+#pragma omp parallel for if (parallelBatches)
+            for (size_t batch = 0; batch < numBatches; ++batch)
+            {
+                size_t offsetA = 0, offsetB = 0;
+                if (!batchC.empty())
+                {
+                    auto index = locate_index(batch, batchC);
+                    offsetA = delocate_index(index, batchA, strideA);
+                    offsetB = delocate_index(index, batchB, strideB);
+                }
+                const T *a = A + offsetA, *b = B + offsetB;
+                T *c = C + batch * m * n;
+                const int inner = parallelBatches ? 1 : threads;
+                if (std::min(m, n) <= SKINNY_MAX)
+                    gemv(*op, a, b, c, m, n, k, bias, inner);
+                else
+                    gemm(cfg, *op, a, b, c, m, n, k, bias, inner > 1);
+            }
+        }
+
+        void compute(const Operator &_op,
+                     const RuntimeObj *context) const override
+        {
+#define CASE(N) \
+    case N:     \
+        doCompute<DT<N>::t>(_op, context)
+
+            int dataTypeIdx = _op->getDType().getIndex();
+            switch (dataTypeIdx)
+            {
+                CASE(1); // DataType::Float32
+                break;
+                CASE(12); // DataType::UInt32
+                break;
+            default:
+                IT_TODO_HALT();
+            }
+        }
+    };
+
+    REGISTER_KERNEL(Device::CPU, OpType::MatMul, CpuMatmul, "matmul_CPU");
+}; // namespace infini
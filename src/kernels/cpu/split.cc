@@ -0,0 +1,44 @@
+#include "operators/split.h"
+#include "core/kernel.h"
+
+namespace infini {
+
+class NaiveSplit : public CpuKernelWithoutConfig {
+    void compute(const Operator &_op,
+                 const RuntimeObj *context) const override {
+        auto op = as<SplitObj>(_op);
+        auto input = op->getInputs(0);
+        auto dim = op->getDim();
+        const auto &inDim = input->getDims();
+        // The input is `outer` rows of `blockOffset` bytes each, and every
+        // output owns one contiguous range of each row.
+        size_t blockOffsetInner = input->getDType().getSize();
+        for (size_t i = inDim.size() - 1; i > (size_t)dim; --i)
+            blockOffsetInner *= inDim[i];
+        size_t blockOffset = inDim[dim] * blockOffsetInner;
+        size_t outer = input->getBytes() / blockOffset;
+        auto inPtr = input->getRawDataPtr<char *>();
+        size_t innerOffset = 0;
+        for (auto &output : op->getOutputs()) {
+            size_t localBlockOffset = output->getDims()[dim] * blockOffsetInner;
+            auto outPtr = output->getRawDataPtr<char *>();
+            // The memory planner may have placed the output inside the
+            // input, see GraphObj::dataMalloc.
+            if (outer == 1 && outPtr == inPtr + innerOffset) {
+                innerOffset += localBlockOffset;
+                continue;
+            }
+#pragma omp parallel for
+            for (size_t o = 0; o < outer; ++o) {
+                std::memcpy(outPtr + o * localBlockOffset,
+                            inPtr + o * blockOffset + innerOffset,
+                            localBlockOffset);
+            }
+            innerOffset += localBlockOffset;
+        }
+    }
+};
+
+REGISTER_KERNEL(Device::CPU, OpType::Split, NaiveSplit, "SplitNaive_CPU");
+
+} // namespace infini
@@ -1,5 +1,6 @@
 #include "operators/transpose.h"
 #include "core/kernel.h"
+#include "utils/data_convert.h"
 
 namespace infini {
 
@@ -15,7 +16,7 @@ inline Shape idx2Pos(const Shape &shape, size_t idx) {
 }
 
 class NaiveTranspose : public CpuKernelWithoutConfig {
-    template <typename T>
+    template <typename TIn, typename TOut = TIn>
     void doCompute(const Operator &_op, const RuntimeObj *context) const {
         auto op = as<TransposeObj>(_op);
         auto inputs = op->getInputs(), outputs = op->getOutputs();
@@ -23,8 +24,8 @@ class NaiveTranspose : public CpuKernelWithoutConfig {
         const auto &perm = op->getPermute();
 
         size_t inSize = inputs[0]->size();
-        auto inPtr = inputs[0]->getRawDataPtr<T *>(),
-             outPtr = outputs[0]->getRawDataPtr<T *>();
+        auto inPtr = inputs[0]->getRawDataPtr<TIn *>();
+        auto outPtr = outputs[0]->getRawDataPtr<TOut *>();
         // #pragma omp parallel for
         for (size_t inIdx = 0; inIdx < inSize; ++inIdx) {
             auto posInput = idx2Pos(inDim, inIdx);
@@ -32,21 +33,34 @@ class NaiveTranspose : public CpuKernelWithoutConfig {
             for (size_t j = 0, jEnd = perm.size(); j < jEnd; ++j) {
                 outIdx = outIdx * inDim[perm[j]] + posInput[perm[j]];
             }
-            outPtr[outIdx] = inPtr[inIdx];
+            outPtr[outIdx] = static_cast<TOut>(inPtr[inIdx]);
         }
     }
 
     void compute(const Operator &_op,
                  const RuntimeObj *context) const override {
-#define CASE(N)                                                                \
-    case N:                                                                    \
-        doCompute<DT<N>::t>(_op, context)
-
-        int dataTypeIdx = _op->getDType().getIndex();
-        switch (dataTypeIdx) {
-            CASE(1); // DataType::Float32
+        // A Cast folded into the transpose converts while moving.
+        if (!(_op->getDType() == _op->getOutDType())) {
+            dispatch_convertible(_op->getDType(), [&](auto in) {
+                dispatch_convertible(_op->getOutDType(), [&](auto out) {
+                    doCompute<decltype(in), decltype(out)>(_op, context);
+                });
+            });
+            return;
+        }
+        // only moves elements, so any type of the same size will do
+        switch (_op->getDType().getSize()) {
+        case 1:
+            doCompute<uint8_t>(_op, context);
+            break;
+        case 2:
+            doCompute<uint16_t>(_op, context);
+            break;
+        case 4:
+            doCompute<uint32_t>(_op, context);
             break;
-            CASE(12); // DataType::UInt32
+        case 8:
+            doCompute<uint64_t>(_op, context);
             break;
         default:
             IT_TODO_HALT();
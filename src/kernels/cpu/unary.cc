@@ -38,6 +38,11 @@ namespace infini
             }
         }
 
+        bool supportsInPlace(const Operator &op, size_t index) const override
+        {
+            return true;
+        }
+
         void compute(const Operator &_op,
                      const RuntimeObj *context) const override
         {
@@ -79,6 +84,11 @@ namespace infini
             }
         }
 
+        bool supportsInPlace(const Operator &op, size_t index) const override
+        {
+            return true;
+        }
+
         void compute(const Operator &_op,
                      const RuntimeObj *context) const override
         {
@@ -27,6 +27,10 @@ optional<vector<Shape>> ConcatObj::inferShape(const TensorVec &inputs) {
     return {{dims}};
 }
 
+vector<int> ConcatObj::getOpAttrVector() const {
+    return {type.underlying(), dim};
+}
+
 std::string ConcatObj::toString() const {
     std::ostringstream os;
     os << "Concat[" << getGuid() << "]";
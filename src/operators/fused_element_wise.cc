@@ -0,0 +1,61 @@
+#include "operators/fused_element_wise.h"
+#include "utils/operator_utils.h"
+
+namespace infini {
+FusedElementWiseObj::FusedElementWiseObj(GraphObj *graph, TensorVec inputs,
+                                         Tensor output,
+                                         vector<ElementWiseInstr> program)
+    : OperatorObj(OpType::FusedElementWise, inputs, {output}),
+      program(std::move(program)) {
+    IT_ASSERT(!this->program.empty());
+    int reg = this->inputs.size();
+    for (auto &instr : this->program) {
+        // operands are read only after they have been written
+        IT_ASSERT(instr.a >= 0 && instr.a < reg);
+        IT_ASSERT(instr.isUnary() || (instr.b >= 0 && instr.b < reg));
+        ++reg;
+    }
+    IT_ASSERT(checkValid(graph));
+}
+
+optional<vector<Shape>>
+FusedElementWiseObj::inferShape(const TensorVec &inputs) {
+    Shape dims = inputs[0]->getDims();
+    for (size_t i = 1; i < inputs.size(); ++i)
+        dims = infer_broadcast(dims, inputs[i]->getDims());
+    return {{dims}};
+}
+
+vector<int> FusedElementWiseObj::getOpAttrVector() const {
+    vector<int> attrs{type.underlying()};
+    for (auto &instr : program) {
+        attrs.insert(attrs.end(), {instr.code, instr.a, instr.b});
+        append_optional_attr(attrs, instr.min);
+        append_optional_attr(attrs, instr.max);
+    }
+    return attrs;
+}
+
+std::string FusedElementWiseObj::toString() const {
+    static const char *names[] = {"Add", "Sub", "Mul", "Div", "Relu", "Clip"};
+    std::ostringstream os;
+    os << "FusedElementWise[" << getGuid() << "]";
+    os << "(";
+    for (auto input : inputs)
+        os << vecToString(input->getDims()) << ",";
+    os << "program=";
+    int reg = inputs.size();
+    for (auto &instr : program) {
+        os << "r" << reg++ << "=" << names[instr.code] << "(r" << instr.a;
+        if (!instr.isUnary())
+            os << ",r" << instr.b;
+        os << ");";
+    }
+    os << "input=";
+    for (auto input : inputs)
+        os << input->getGuid() << ",";
+    os << "output=" << outputs[0]->getGuid() << ")";
+    return os.str();
+}
+
+} // namespace infini
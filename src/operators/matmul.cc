@@ -5,9 +5,12 @@ namespace infini
 {
 
     MatmulObj::MatmulObj(GraphObj *graph, Tensor A, Tensor B, Tensor C, bool transA,
-                         bool transB)
-        : OperatorObj(OpType::MatMul, TensorVec{A, B}, {C}),
-          transA(transA), transB(transB)
+                         bool transB, Tensor bias, ActType act,
+                         std::optional<float> min, std::optional<float> max)
+        : OperatorObj(OpType::MatMul,
+                      bias ? TensorVec{A, B, bias} : TensorVec{A, B}, {C}),
+          transA(transA), transB(transB), act(act), minValue(min),
+          maxValue(max)
     {
         IT_ASSERT(checkValid(graph));
     }
@@ -17,11 +20,26 @@ namespace infini
         std::ostringstream os;
         os << "Matmul([" << (transA ? "A^T" : "A") << "," << (transB ? "B^T" : "B]")
            << ",A=" << inputs[0]->getGuid()
-           << ",B=" << inputs[1]->getGuid() << ",C=" << outputs[0]->getGuid()
-           << ",mnk=[" << m << "," << n << "," << k << "])";
+           << ",B=" << inputs[1]->getGuid() << ",C=" << outputs[0]->getGuid();
+        if (auto bias = getBias())
+            os << ",bias=" << bias->getGuid();
+        if (act == ActType::Relu)
+            os << ",act=Relu";
+        else if (act == ActType::Clip)
+            os << ",act=Clip";
+        os << ",mnk=[" << m << "," << n << "," << k << "])";
         return os.str();
     }
 
+    vector<int> MatmulObj::getOpAttrVector() const
+    {
+        vector<int> attrs{type.underlying(), transA, transB,
+                          enum_to_underlying(act)};
+        append_optional_attr(attrs, minValue);
+        append_optional_attr(attrs, maxValue);
+        return attrs;
+    }
+
     optional<vector<Shape>> MatmulObj::inferShape(const TensorVec &inputs)
     {
         // =================================== 作业 ===================================
@@ -39,6 +57,11 @@ namespace infini
         int kA = transA ? shape_A[rankA - 2] : shape_A[rankA - 1];
         int kB = transB ? shape_B[rankB - 1] : shape_B[rankB - 2];
         int n = transB ? shape_B[rankB - 2] : shape_B[rankB - 1];
+        if (kA != kB)
+            return std::nullopt;
+        this->m = m;
+        this->n = n;
+        this->k = kA;
         
         // 获取 batch 维度
         Shape batchA(shape_A.begin(), shape_A.end() - 2);
@@ -60,7 +83,21 @@ namespace infini
         Shape shape_C = batchC;
         shape_C.push_back(m);
         shape_C.push_back(n);
-        
+
+        // 偏置只沿最后两维广播，不能改变输出的形状
+        if (inputs.size() > 2)
+        {
+            auto shape_bias = inputs[2]->getDims();
+            int rankBias = shape_bias.size();
+            for (int i = 0; i < rankBias - 2; ++i)
+            {
+                if (shape_bias[i] != 1)
+                    return std::nullopt;
+            }
+            if (infer_broadcast(shape_C, shape_bias) != shape_C)
+                return std::nullopt;
+        }
+
         return {{shape_C}};
     }
 
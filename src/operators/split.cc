@@ -0,0 +1,50 @@
+#include "operators/split.h"
+#include "utils/operator_utils.h"
+
+namespace infini {
+SplitObj::SplitObj(GraphObj *graph, Tensor input,
+                   std::optional<TensorVec> outputs, int _dim,
+                   vector<int> sizes)
+    : OperatorObj(OpType::Split, {input},
+                  outputs ? *outputs : TensorVec(sizes.size(), nullptr)),
+      sizes(std::move(sizes)) {
+    int rank = input->getRank();
+    dim = get_real_axis(_dim, rank);
+    IT_ASSERT(this->outputs.size() == this->sizes.size());
+    IT_ASSERT(checkValid(graph));
+}
+
+optional<vector<Shape>> SplitObj::inferShape(const TensorVec &inputs) {
+    Shape dims = inputs[0]->getDims();
+    if (std::accumulate(sizes.begin(), sizes.end(), 0) != dims[dim])
+        return std::nullopt;
+    vector<Shape> shapes;
+    for (auto size : sizes) {
+        dims[dim] = size;
+        shapes.emplace_back(dims);
+    }
+    return shapes;
+}
+
+vector<int> SplitObj::getOpAttrVector() const {
+    vector<int> attrs{type.underlying(), dim};
+    attrs.insert(attrs.end(), sizes.begin(), sizes.end());
+    return attrs;
+}
+
+std::string SplitObj::toString() const {
+    std::ostringstream os;
+    os << "Split[" << getGuid() << "]";
+    os << "(";
+    os << vecToString(inputs[0]->getDims()) << ",";
+    os << "dim=" << dim << ",";
+    os << "sizes=" << vecToString(sizes) << ",";
+    os << "input=" << inputs[0]->getGuid() << ",";
+    os << "output=";
+    for (auto output : outputs)
+        os << output->getGuid() << ",";
+    os << ")";
+    return os.str();
+}
+
+} // namespace infini
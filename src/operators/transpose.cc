@@ -9,6 +9,7 @@ namespace infini
         auto rank = input->getRank();
         if (permute.empty())
         {
+            transposePermute.resize(rank);
             for (size_t i = 0; i < rank; ++i)
             {
                 transposePermute[i] = i;
@@ -43,6 +44,21 @@ namespace infini
         return {{output_dim}};
     }
 
+    void TransposeObj::setPermute(vector<int> permute)
+    {
+        IT_ASSERT(permute.size() == transposePermute.size());
+        transposePermute = std::move(permute);
+        IT_ASSERT(checkValid(nullptr));
+    }
+
+    vector<int> TransposeObj::getOpAttrVector() const
+    {
+        vector<int> attrs{type.underlying()};
+        attrs.insert(attrs.end(), transposePermute.begin(),
+                     transposePermute.end());
+        return attrs;
+    }
+
     std::string TransposeObj::toString() const
     {
         std::ostringstream os;
@@ -1,4 +1,5 @@
 #include "operators/unary.h"
+#include "utils/operator_utils.h"
 
 namespace infini
 {
@@ -25,6 +26,11 @@ namespace infini
         return os.str();
     }
 
+    vector<int> UnaryObj::getOpAttrVector() const
+    {
+        return {type.underlying()};
+    }
+
     ClipObj::ClipObj(GraphObj *graph, Tensor input, Tensor output,
                      std::optional<float> min, std::optional<float> max)
         : OperatorObj(OpType::Clip, {input}, {output}), minValue(min),
@@ -56,6 +62,14 @@ namespace infini
         return os.str();
     }
 
+    vector<int> ClipObj::getOpAttrVector() const
+    {
+        vector<int> attrs{type.underlying()};
+        append_optional_attr(attrs, minValue);
+        append_optional_attr(attrs, maxValue);
+        return attrs;
+    }
+
     CastObj::CastObj(GraphObj *graph, Tensor input, Tensor output, CastType type)
         : OperatorObj(OpType::Cast, {input}, {output}), castType(type)
     {
@@ -91,6 +105,11 @@ namespace infini
         return os.str();
     }
 
+    vector<int> CastObj::getOpAttrVector() const
+    {
+        return {type.underlying(), enum_to_underlying(castType)};
+    }
+
     DataType CastObj::getOutputDataType() const
     {
         switch (castType)
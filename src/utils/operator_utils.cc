@@ -1,5 +1,6 @@
 #include "utils/operator_utils.h"
 #include "core/runtime.h"
+#include <cstring>
 
 namespace infini {
 
@@ -69,6 +70,15 @@ size_t delocate_index(const Shape &shapeIndex, const Shape &shape,
     return ans;
 }
 
+void append_optional_attr(vector<int> &attrs,
+                          const std::optional<float> &value) {
+    attrs.emplace_back(value.has_value());
+    int bits = 0;
+    if (value)
+        std::memcpy(&bits, &*value, sizeof(bits));
+    attrs.emplace_back(bits);
+}
+
 std::string device_to_str(Device device) {
     std::string deviceStr;
     switch (device) {
@@ -71,4 +71,52 @@ namespace infini
         EXPECT_EQ(ptr1, ptr2);
     }
 
+    TEST(Allocator, testPolicies)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        auto run = [&](AllocPolicy policy)
+        {
+            Allocator allocator = Allocator(runtime, policy);
+            // free blocks of 64, 128 and 48 bytes, separated by used ones
+            size_t offsetA = allocator.alloc(64);
+            allocator.alloc(8);
+            size_t offsetB = allocator.alloc(128);
+            allocator.alloc(8);
+            size_t offsetC = allocator.alloc(48);
+            allocator.alloc(8);
+            allocator.free(offsetA, 64);
+            allocator.free(offsetB, 128);
+            allocator.free(offsetC, 48);
+            return vector<size_t>{allocator.alloc(48), offsetA, offsetB,
+                                  offsetC};
+        };
+        auto first = run(AllocPolicy::FirstFit);
+        EXPECT_EQ(first[0], first[1]);
+        auto best = run(AllocPolicy::BestFit);
+        EXPECT_EQ(best[0], best[3]);
+        auto worst = run(AllocPolicy::WorstFit);
+        EXPECT_EQ(worst[0], worst[2]);
+    }
+
+    TEST(Allocator, testPlan)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        // x dies after step 0, but online allocation cannot fit z into its
+        // hole because y sits right behind it.
+        vector<MemoryRequest> requests = {
+            {96, 0, 0},  // x
+            {8, 0, 2},   // y
+            {160, 1, 2}, // z
+        };
+        Allocator online = Allocator(runtime);
+        online.replay(requests);
+        EXPECT_EQ(online.getPeak(), 96 + 8 + 160);
+
+        Allocator offline = Allocator(runtime);
+        auto offsets = offline.plan(requests);
+        EXPECT_EQ(offline.getLowerBound(requests), 160 + 8);
+        EXPECT_EQ(offline.getPeak(), 160 + 8);
+        EXPECT_EQ(offsets[0], offsets[2]);
+    }
+
 } // namespace infini
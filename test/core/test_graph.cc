@@ -1,8 +1,11 @@
 #include "core/graph.h"
 #include "core/kernel.h"
 #include "core/runtime.h"
+#include "operators/concat.h"
+#include "operators/element_wise.h"
 #include "operators/matmul.h"
 #include "operators/transpose.h"
+#include "operators/unary.h"
 
 #include "test.h"
 
@@ -37,4 +40,260 @@ namespace infini
         EXPECT_EQ(op->getTransA(), false);
         EXPECT_EQ(op->getTransB(), true);
     }
-}
\ No newline at end of file
+
+    TEST(Graph, TopoSort)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor i = g->addTensor({1, 4}, DataType::Float32);
+        Tensor a = g->addTensor({1, 4}, DataType::Float32);
+        Tensor b = g->addTensor({2, 4}, DataType::Float32);
+        Tensor c = g->addTensor({1, 4}, DataType::Float32);
+        Tensor o = g->addTensor({3, 4}, DataType::Float32);
+        // 按逆序添加算子
+        auto opD = g->addOpWithOutputs<ConcatObj>(TensorVec{b, c}, o, 0);
+        auto opC = g->addOpWithOutputs<ReluObj>(a, c);
+        auto opB = g->addOpWithOutputs<ConcatObj>(TensorVec{i, i}, b, 0);
+        auto opA = g->addOpWithOutputs<ReluObj>(i, a);
+        auto order = [&]()
+        {
+            EXPECT_TRUE(g->topo_sort());
+            return g->getOperators();
+        };
+        // Original: ready ops in the order they were added
+        EXPECT_EQ(order(), (OpVec{opB, opA, opC, opD}));
+        // MemoryFirst: C frees a as soon as it is placed, B only allocates
+        g->setSortPolicy(TopoSortPolicy::MemoryFirst);
+        EXPECT_EQ(order(), (OpVec{opA, opC, opB, opD}));
+        // CriticalPath: A heads the heavier path
+        g->setSortPolicy(TopoSortPolicy::CriticalPath);
+        EXPECT_EQ(order(), (OpVec{opA, opB, opC, opD}));
+        // 环
+        Tensor x = g->addTensor({1, 4}, DataType::Float32);
+        Tensor y = g->addTensor({1, 4}, DataType::Float32);
+        g->addOpWithOutputs<ReluObj>(x, y);
+        g->addOpWithOutputs<ReluObj>(y, x);
+        EXPECT_FALSE(g->topo_sort());
+    }
+
+    TEST(Graph, RemoveBatched)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        TensorVec tensors{g->addTensor({1, 4}, DataType::Float32)};
+        OpVec ops;
+        for (int i = 0; i < 6; ++i)
+        {
+            ops.emplace_back(g->addOp<ReluObj>(tensors.back(), nullptr));
+            tensors.emplace_back(ops.back()->getOutput());
+        }
+        g->removeOperators({ops[4], ops[1], ops[2]});
+        g->removeTensors({tensors[5], tensors[2]});
+        g->removeTensor(tensors[5]); // 已删除
+        EXPECT_EQ(g->getOperators(), (OpVec{ops[0], ops[3], ops[5]}));
+        EXPECT_EQ(g->getTensors(), (TensorVec{tensors[0], tensors[1], tensors[3],
+                                              tensors[4], tensors[6]}));
+        EXPECT_FALSE(g->hasOperator(ops[1]));
+        EXPECT_TRUE(g->hasOperator(ops[5]));
+        EXPECT_EQ(g->getTensor(tensors[4]->getFuid()), tensors[4]);
+        EXPECT_EQ(g->getTensor(tensors[2]->getFuid()), nullptr);
+        // 删除后索引仍然有效
+        g->removeOperator(ops[5]);
+        g->removeTensor(tensors[6]);
+        EXPECT_EQ(g->getOperators(), (OpVec{ops[0], ops[3]}));
+        EXPECT_EQ(g->getTensor(tensors[4]->getFuid()), tensors[4]);
+        EXPECT_EQ(g->getTensor(tensors[6]->getFuid()), nullptr);
+    }
+
+    TEST(Graph, CheckValid)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor t = g->addTensor({1, 4}, DataType::Float32);
+        OpVec ops;
+        for (int i = 0; i < 4; ++i)
+        {
+            ops.emplace_back(g->addOp<ReluObj>(t, nullptr));
+            t = ops.back()->getOutput();
+        }
+        EXPECT_TRUE(g->checkValid());
+        EXPECT_TRUE(g->checkValid(true));
+        // 只删除算子而不断开连接，它的输入输出仍然指向它
+        g->removeOperator(ops[2]);
+        EXPECT_THROW(g->checkValid(true), Exception);
+        EXPECT_THROW(g->checkValid(), Exception);
+        // 重复的 FUID
+        Graph h = make_ref<GraphObj>(runtime);
+        Tensor x = h->addTensor({1, 4}, DataType::Float32);
+        h->addOp<ReluObj>(x, nullptr);
+        h->addTensor(x);
+        EXPECT_THROW(h->checkValid(), Exception);
+    }
+
+    TEST(Graph, DataMallocReuse)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor i = g->addTensor({2, 3, 4, 5}, DataType::Float32);
+        Tensor t = i;
+        for (int step = 0; step < 4; ++step)
+            t = g->addOp<ReluObj>(t, nullptr)->getOutput();
+        g->dataMalloc();
+        // The input is pinned and every Relu after the first one runs in
+        // place, so the whole chain needs two buffers.
+        auto stats = g->getMemoryStats();
+        EXPECT_EQ(stats.tensorBytes, 5 * i->getBytes());
+        EXPECT_EQ(stats.arenaBytes, 2 * i->getBytes());
+        EXPECT_NE(i->getRawDataPtr<void *>(), t->getRawDataPtr<void *>());
+
+        i->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(t->equalData(i));
+    }
+
+    TEST(Graph, DataMallocOffline)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor i = g->addTensor({2, 3, 4, 5}, DataType::Float32);
+        Tensor t = i;
+        for (int step = 0; step < 4; ++step)
+            t = g->addOp<ReluObj>(t, nullptr)->getOutput();
+        g->dataMalloc(MemoryStrategy::Offline);
+        auto stats = g->getMemoryStats();
+        EXPECT_EQ(stats.lowerBoundBytes, 2 * i->getBytes());
+        EXPECT_EQ(stats.arenaBytes, stats.lowerBoundBytes);
+        EXPECT_GE(stats.onlineBytes, stats.arenaBytes);
+
+        i->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(t->equalData(i));
+    }
+
+    TEST(Graph, DataMallocInPlace)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor i0 = g->addTensor({2, 3}, DataType::Float32);
+        Tensor i1 = g->addTensor({3}, DataType::Float32);
+        auto relu = g->addOp<ReluObj>(i0, nullptr);
+        auto add = g->addOp<AddObj>(i1, relu->getOutput(), nullptr);
+        auto clip = g->addOp<ClipObj>(add->getOutput(), nullptr, 2.0f, 4.0f);
+        g->dataMalloc();
+        // Add writes over the Relu output, not the broadcast input, and Clip
+        // writes over the Add output.
+        auto ptr = relu->getOutput()->getRawDataPtr<void *>();
+        EXPECT_EQ(add->getOutput()->getRawDataPtr<void *>(), ptr);
+        EXPECT_EQ(clip->getOutput()->getRawDataPtr<void *>(), ptr);
+
+        i0->setData(IncrementalGenerator());
+        i1->setData(OneGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(clip->getOutput()->equalData(vector<float>{2, 2, 3, 4, 4, 4}));
+    }
+
+    TEST(Graph, DataMallocWeights)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 4}, DataType::Float32);
+        Tensor w = g->addTensor({4}, DataType::Float32);
+        w->setWeight();
+        auto add = g->addOp<AddObj>(x, w, nullptr);
+        auto relu = g->addOp<ReluObj>(add->getOutput(), nullptr);
+        g->dataMalloc();
+        EXPECT_EQ(g->getMemoryStats().weightBytes, w->getBytes());
+        w->setData(IncrementalGenerator());
+        auto weightPtr = w->getRawDataPtr<void *>();
+
+        // a new input shape re-plans the activations but keeps the weights
+        x->setShape({4, 4});
+        g->shape_infer();
+        g->dataMalloc();
+        EXPECT_EQ(w->getRawDataPtr<void *>(), weightPtr);
+        EXPECT_EQ(g->getMemoryStats().tensorBytes, 3 * x->getBytes());
+        x->setData(OneGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(relu->getOutput()->equalData(
+            vector<float>{1, 2, 3, 4, 1, 2, 3, 4, 1, 2, 3, 4, 1, 2, 3, 4}));
+    }
+
+    TEST(Graph, FoldConstants)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({4, 2}, DataType::Float32);
+        Tensor w = g->addTensor({3, 2}, DataType::Float32);
+        w->setWeight();
+        auto t = g->addOp<TransposeObj>(w, nullptr, Shape{1, 0})->getOutput();
+        auto r = g->addOp<ReluObj>(t, nullptr)->getOutput();
+        auto y = g->addOp<MatmulObj>(x, r, nullptr)->getOutput();
+        g->dataMalloc();
+        size_t arenaBefore = g->getMemoryStats().arenaBytes;
+        x->setData(IncrementalGenerator());
+        w->setData(IncrementalGenerator());
+        runtime->run(g);
+        auto ptr = y->getRawDataPtr<float *>();
+        vector<float> expected(ptr, ptr + y->size());
+
+        // Transpose 和 Relu 只依赖权重，折叠后只剩 Matmul
+        EXPECT_EQ(g->foldConstants(), 2u);
+        EXPECT_EQ(g->getOperators().size(), 1u);
+        EXPECT_EQ(g->getTensors().size(), 3u);
+        EXPECT_TRUE(r->isWeight());
+        EXPECT_FALSE(g->hasTensor(t));
+        EXPECT_TRUE(g->checkValid());
+        g->dataMalloc();
+        EXPECT_LT(g->getMemoryStats().arenaBytes, arenaBefore);
+        x->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(y->equalData(expected));
+    }
+
+    TEST(Graph, FoldConstantsSkipsHalf)
+    {
+        // CPU kernels cannot convert Float16, folding must not run the Cast
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 2}, DataType::Float32);
+        Tensor w = g->addTensor({2, 2}, DataType::Float16);
+        w->setWeight();
+        auto cast = g->addOp<CastObj>(w, nullptr, CastType::Float162Float);
+        g->addOp<AddObj>(x, cast->getOutput(), nullptr);
+        g->dataMalloc();
+        EXPECT_EQ(g->foldConstants(), 0u);
+        EXPECT_TRUE(g->hasOperator(cast));
+    }
+
+    TEST(Graph, DeadCode)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 3}, DataType::Float32);
+        auto y = g->addOp<ReluObj>(x, nullptr)->getOutput();
+        // 调试用的分支，只有 debug 依赖它
+        auto t = g->addOp<TransposeObj>(x, nullptr, Shape{1, 0})->getOutput();
+        auto debug = g->addOp<ReluObj>(t, nullptr)->getOutput();
+        g->dataMalloc();
+        size_t arenaBefore = g->getMemoryStats().arenaBytes;
+        EXPECT_EQ(g->getProducers({y}).size(), 1u);
+        EXPECT_EQ(g->getProducers({debug}).size(), 2u);
+
+        // 只计算请求的输出
+        x->setData(IncrementalGenerator());
+        debug->setData(ValGenerator<7>());
+        runtime->run(g, {y});
+        EXPECT_TRUE(y->equalData(vector<float>{0, 1, 2, 3, 4, 5}));
+        EXPECT_TRUE(debug->equalData(vector<float>(6, 7)));
+
+        EXPECT_EQ(g->eliminateDeadCode({y}), 2u);
+        EXPECT_EQ(g->getOperators().size(), 1u);
+        EXPECT_EQ(g->getTensors().size(), 2u);
+        EXPECT_FALSE(g->hasTensor(t));
+        EXPECT_FALSE(g->hasTensor(debug));
+        EXPECT_TRUE(g->checkValid());
+        EXPECT_EQ(g->eliminateDeadCode({y}), 0u);
+        g->dataMalloc();
+        EXPECT_LT(g->getMemoryStats().arenaBytes, arenaBefore);
+    }
+}
@@ -0,0 +1,534 @@
+#include "core/graph.h"
+#include "core/graph_rewrite.h"
+#include "core/runtime.h"
+#include "operators/concat.h"
+#include "operators/element_wise.h"
+#include "operators/fused_element_wise.h"
+#include "operators/matmul.h"
+#include "operators/split.h"
+#include "operators/transpose.h"
+#include "operators/unary.h"
+
+#include "test.h"
+
+namespace infini
+{
+    TEST(GraphRewrite, Pattern)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 3}, DataType::Float32);
+        auto relu = g->addOp<ReluObj>(x, nullptr);
+        auto add = g->addOp<AddObj>(relu->getOutput(), relu->getOutput(),
+                                    nullptr);
+        auto other = g->addOp<ReluObj>(relu->getOutput(), nullptr);
+
+        OpVec matched;
+        EXPECT_TRUE(Pattern(OpType::Add)
+                        .input(0, Pattern(OpType::Relu))
+                        .input(1, Pattern())
+                        .match(add, matched));
+        EXPECT_EQ(matched, (OpVec{add, relu, relu}));
+        // relu has two consumer ops
+        matched.clear();
+        EXPECT_FALSE(Pattern(OpType::Add)
+                         .input(0, Pattern(OpType::Relu).singleUse())
+                         .match(add, matched));
+        EXPECT_TRUE(matched.empty());
+        // a failing predicate drops the producers matched so far
+        EXPECT_FALSE(Pattern(OpType::Relu)
+                         .input(0, Pattern(OpType::Relu))
+                         .where([](const Operator &) { return false; })
+                         .match(other, matched));
+        EXPECT_TRUE(matched.empty());
+        EXPECT_FALSE(Pattern(OpType::Relu)
+                         .input(0, Pattern(OpType::Relu))
+                         .match(relu, matched));
+    }
+
+    TEST(GraphRewrite, Fixpoint)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 3}, DataType::Float32);
+        Tensor y = g->addTensor({2, 3}, DataType::Float32);
+        Tensor t = x;
+        for (int i = 0; i < 5; ++i)
+            t = g->addOp<ReluObj>(t, nullptr)->getOutput();
+        auto add = g->addOp<AddObj>(t, y, nullptr);
+
+        // Relu(Relu(x)) = Relu(x)
+        RewriteEngine engine;
+        engine.addRule({"ReluIdempotent",
+                        Pattern(OpType::Relu).input(0, Pattern(OpType::Relu)),
+                        [](GraphObj &g, const OpVec &m)
+                        {
+                            if (m[0]->getOutput()->getTargets().empty())
+                                return false;
+                            g.replaceAllUses(m[0]->getOutput(),
+                                             m[1]->getOutput());
+                            g.eraseOperator(m[0]);
+                            return true;
+                        }});
+        EXPECT_EQ(engine.run(*g), 4u);
+        EXPECT_EQ(engine.getStats()[0].hits, 4u);
+        EXPECT_EQ(g->getOperators().size(), 2u);
+        EXPECT_EQ(g->getTensors().size(), 4u);
+        EXPECT_EQ(g->getOperators()[0]->getInputs(0), x);
+        EXPECT_EQ(g->getOperators()[1], add);
+        EXPECT_TRUE(g->checkValid());
+    }
+
+    TEST(GraphRewrite, CancelTransposeSharedProducer)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 3, 4}, DataType::Float32);
+        auto t1 = g->addOp<TransposeObj>(x, nullptr, Shape{1, 2, 0});
+        auto t2 = g->addOp<TransposeObj>(t1->getOutput(), nullptr,
+                                         Shape{2, 0, 1});
+        auto r1 = g->addOp<ReluObj>(t1->getOutput(), nullptr);
+        auto r2 = g->addOp<ReluObj>(t2->getOutput(), nullptr);
+        g->optimize();
+        // the second transpose undoes the first one, which has another user
+        EXPECT_EQ(g->getOperators().size(), 3u);
+        EXPECT_FALSE(g->hasOperator(t2));
+        EXPECT_EQ(r2->getInputs(0), x);
+        EXPECT_EQ(r1->getInputs(0), t1->getOutput());
+        EXPECT_TRUE(g->checkValid());
+    }
+
+    TEST(GraphRewrite, ComposeTransposes)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        // NHWC -> NCHW -> NHWC，合并后是恒等排列
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 3, 4, 5}, DataType::Float32);
+        auto t1 = g->addOp<TransposeObj>(x, nullptr, Shape{0, 3, 1, 2});
+        auto t2 = g->addOp<TransposeObj>(t1->getOutput(), nullptr,
+                                         Shape{0, 2, 3, 1});
+        auto relu = g->addOp<ReluObj>(t2->getOutput(), nullptr);
+        auto stats = g->optimize();
+        auto compose = std::find_if(stats.begin(), stats.end(),
+                                    [](const RewriteStats &s)
+                                    { return s.name == "ComposeTransposes"; });
+        ASSERT_NE(compose, stats.end());
+        EXPECT_EQ(compose->hits, 1u);
+        EXPECT_EQ(g->getOperators(), (OpVec{relu}));
+        EXPECT_EQ(relu->getInputs(0), x);
+
+        // 三个 Transpose 合并为一个，结果不变
+        auto build = [&](Graph g)
+        {
+            Tensor x = g->addTensor({2, 3, 4}, DataType::Float32);
+            Tensor t = x;
+            for (auto perm : {Shape{1, 0, 2}, Shape{0, 2, 1}, Shape{2, 1, 0}})
+                t = g->addOp<TransposeObj>(t, nullptr, perm)->getOutput();
+            g->dataMalloc();
+            x->setData(IncrementalGenerator());
+            return t;
+        };
+        Graph ref = make_ref<GraphObj>(runtime);
+        Tensor expected = build(ref);
+        runtime->run(ref);
+        g = make_ref<GraphObj>(runtime);
+        Tensor y = build(g);
+        g->optimize();
+        ASSERT_EQ(g->getOperators().size(), 1u);
+        EXPECT_EQ(as<TransposeObj>(g->getOperators()[0])->getPermute(),
+                  (vector<int>{0, 2, 1}));
+        EXPECT_EQ(g->getOperators()[0]->getOutput(), y);
+        g->dataMalloc();
+        g->getInputs()[0]->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(y->equalData(expected));
+    }
+
+    TEST(GraphRewrite, CommonSubexpressions)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 3}, DataType::Float32);
+        auto t1 = g->addOp<TransposeObj>(x, nullptr, Shape{1, 0});
+        auto t2 = g->addOp<TransposeObj>(x, nullptr, Shape{1, 0});
+        auto t3 = g->addOp<TransposeObj>(x, nullptr, Shape{0, 1});
+        auto r1 = g->addOp<ReluObj>(t1->getOutput(), nullptr);
+        auto r2 = g->addOp<ReluObj>(t2->getOutput(), nullptr);
+        auto add = g->addOp<AddObj>(r1->getOutput(), r2->getOutput(), nullptr);
+        auto r3 = g->addOp<ReluObj>(t3->getOutput(), nullptr);
+        auto r4 = g->addOp<ReluObj>(t3->getOutput(), nullptr);
+        // t2 和 r2 与 t1、r1 重复；r4 与 r3 重复但两者都是图的输出
+        EXPECT_EQ(eliminateCommonSubexpressions(*g), 2u);
+        EXPECT_EQ(g->getOperators().size(), 6u);
+        EXPECT_FALSE(g->hasOperator(t2));
+        EXPECT_FALSE(g->hasOperator(r2));
+        EXPECT_EQ(add->getInputs(0), r1->getOutput());
+        EXPECT_EQ(add->getInputs(1), r1->getOutput());
+        EXPECT_TRUE(g->hasOperator(r4));
+        EXPECT_TRUE(g->checkValid());
+    }
+
+    TEST(GraphRewrite, CommonSubexpressionKeepsOutputs)
+    {
+        // y1 = Relu(x) 是图的输出，另一个 Relu(x) 只被 Add 使用：
+        // 合并会让 y1 变成中间结果，随后被 FuseElementWise 吃掉
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 3}, DataType::Float32);
+        Tensor c = g->addTensor({2, 3}, DataType::Float32);
+        auto y1 = g->addOp<ReluObj>(x, nullptr)->getOutput();
+        auto r = g->addOp<ReluObj>(x, nullptr)->getOutput();
+        auto y2 = g->addOp<AddObj>(r, c, nullptr)->getOutput();
+        EXPECT_EQ(eliminateCommonSubexpressions(*g), 0u);
+        auto stats = g->optimize();
+        EXPECT_EQ(stats[0].name, "CommonSubexpressionElimination");
+        EXPECT_EQ(stats[0].hits, 0u);
+        EXPECT_EQ(g->getOutputs().size(), 2u);
+        EXPECT_TRUE(g->hasTensor(y1));
+        EXPECT_TRUE(g->hasTensor(y2));
+        g->dataMalloc();
+        x->setData(IncrementalGenerator());
+        c->setData(OneGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(y1->equalData(vector<float>{0, 1, 2, 3, 4, 5}));
+        EXPECT_TRUE(y2->equalData(vector<float>{1, 2, 3, 4, 5, 6}));
+    }
+
+    TEST(GraphRewrite, AlgebraicSimplification)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 3}, DataType::Float32);
+        Tensor zero = g->addTensor({3}, DataType::Float32);
+        Tensor one = g->addTensor({1}, DataType::Float32);
+        Tensor two = g->addTensor({1}, DataType::Float32);
+        for (auto &w : {zero, one, two})
+            w->setWeight();
+        auto t = g->addOp<AddObj>(x, zero, nullptr)->getOutput();
+        t = g->addOp<MulObj>(one, t, nullptr)->getOutput();
+        t = g->addOp<DivObj>(t, two, nullptr)->getOutput();
+        t = g->addOp<ReluObj>(t, nullptr)->getOutput();
+        t = g->addOp<ClipObj>(t, nullptr, std::nullopt, 1.5f)->getOutput();
+        auto y = g->addOp<ClipObj>(t, nullptr, -1.f, 1.f)->getOutput();
+        auto r = g->addOp<ReluObj>(x, nullptr)->getOutput();
+        auto z = g->addOp<ReluObj>(r, nullptr)->getOutput();
+        auto h = g->addOp<DivObj>(x, two, nullptr)->getOutput();
+        g->dataMalloc();
+        zero->setData(ValGenerator<0>());
+        one->setData(ValGenerator<1>());
+        two->setData(ValGenerator<2>());
+
+        RewriteEngine engine(getOptimizePhases()[0]);
+        EXPECT_GT(engine.run(*g), 0u);
+        // 剩下 x * 0.5 → Clip(0, 1)、一个 Relu，以及 x * 0.5
+        ASSERT_EQ(g->getOperators().size(), 4u);
+        auto ops = g->getOperators();
+        EXPECT_EQ(ops[0]->getOpType(), OpType::Mul);
+        EXPECT_EQ(ops[0]->getInputs(0), x);
+        auto clip = as<ClipObj>(y->getSource());
+        EXPECT_EQ(clip->getMin(), 0.f);
+        EXPECT_EQ(clip->getMax(), 1.f);
+        EXPECT_EQ(z->getSource()->getOpType(), OpType::Relu);
+        EXPECT_EQ(z->getSource()->getInputs(0), x);
+        // 两个除以 two 的 Div 共用同一个倒数常量
+        EXPECT_EQ(h->getSource()->getOpType(), OpType::Mul);
+        EXPECT_EQ(h->getSource()->getInputs(1), ops[0]->getInputs(1));
+        EXPECT_FALSE(g->hasTensor(zero));
+        EXPECT_FALSE(g->hasTensor(two));
+        EXPECT_TRUE(g->checkValid());
+
+        g->dataMalloc();
+        x->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(y->equalData(vector<float>{0, 0.5, 1, 1, 1, 1}));
+        EXPECT_TRUE(h->equalData(vector<float>{0, 0.5, 1, 1.5, 2, 2.5}));
+        EXPECT_TRUE(z->equalData(vector<float>{0, 1, 2, 3, 4, 5}));
+    }
+
+    TEST(GraphRewrite, SinkTransposes)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        // Matmul(Relu(T(x) + T(y)), w)，Transpose 下沉后并入 Matmul
+        auto build = [](Graph g)
+        {
+            Tensor x = g->addTensor({2, 3}, DataType::Float32);
+            Tensor y = g->addTensor({2, 3}, DataType::Float32);
+            Tensor w = g->addTensor({2, 4}, DataType::Float32);
+            auto tx = g->addOp<TransposeObj>(x, nullptr, Shape{1, 0});
+            auto ty = g->addOp<TransposeObj>(y, nullptr, Shape{1, 0});
+            auto t = g->addOp<AddObj>(tx->getOutput(), ty->getOutput(), nullptr)
+                         ->getOutput();
+            t = g->addOp<ReluObj>(t, nullptr)->getOutput();
+            t = g->addOp<MatmulObj>(t, w, nullptr)->getOutput();
+            g->dataMalloc();
+            x->setData(IncrementalGenerator());
+            y->setData(ValGenerator<-2>());
+            w->setData(IncrementalGenerator());
+            return t;
+        };
+        Graph ref = make_ref<GraphObj>(runtime);
+        Tensor expected = build(ref);
+        runtime->run(ref);
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor out = build(g);
+        g->optimize();
+        EXPECT_EQ(g->getOperators().size(), 2u);
+        auto matmul = as<MatmulObj>(out->getSource());
+        EXPECT_TRUE(matmul->getTransA());
+        g->dataMalloc();
+        auto inputs = g->getInputs();
+        inputs[0]->setData(IncrementalGenerator());
+        inputs[1]->setData(ValGenerator<-2>());
+        inputs[2]->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(out->equalData(expected));
+
+        // Relu(T(Concat(T(a), T(b), axis 0)))：两次转置抵消，Concat 改为轴 1
+        g = make_ref<GraphObj>(runtime);
+        Tensor a = g->addTensor({2, 3}, DataType::Float32);
+        Tensor b = g->addTensor({2, 5}, DataType::Float32);
+        auto ta = g->addOp<TransposeObj>(a, nullptr, Shape{1, 0})->getOutput();
+        auto tb = g->addOp<TransposeObj>(b, nullptr, Shape{1, 0})->getOutput();
+        auto c = g->addOp<ConcatObj>(TensorVec{ta, tb}, nullptr, 0)->getOutput();
+        auto t = g->addOp<TransposeObj>(c, nullptr, Shape{1, 0})->getOutput();
+        auto r = g->addOp<ReluObj>(t, nullptr)->getOutput();
+        g->optimize();
+        ASSERT_EQ(g->getOperators().size(), 2u);
+        auto concat = as<ConcatObj>(g->getOperators()[0]);
+        EXPECT_EQ(concat->getDim(), 1);
+        EXPECT_EQ(concat->getInputs(), (TensorVec{a, b}));
+        EXPECT_EQ(r->getSource()->getInputs(0), concat->getOutput());
+        EXPECT_TRUE(g->checkValid());
+
+        // T(x) * s 写图输出时，交换两者省不掉任何一遍读写，保持原样
+        g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 3}, DataType::Float32);
+        Tensor s = g->addTensor({1}, DataType::Float32);
+        auto tx = g->addOp<TransposeObj>(x, nullptr, Shape{1, 0})->getOutput();
+        auto y = g->addOp<MulObj>(tx, s, nullptr)->getOutput();
+        g->optimize();
+        ASSERT_EQ(g->getOperators().size(), 2u);
+        EXPECT_EQ(y->getSource()->getOpType(), OpType::Mul);
+        EXPECT_EQ(y->getSource()->getInputs(0), tx);
+    }
+
+    TEST(GraphRewrite, CastFolding)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        // Concat(e, e)，e = Cast(Cast(Cast(T(Cast(x, Float2Float)), Float2Int32),
+        // Int322Int64), Int642Int32)：只剩一个边转置边转换的 Transpose
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 3}, DataType::Float32);
+        auto t = g->addOp<CastObj>(x, nullptr, CastType::Float2Float)->getOutput();
+        t = g->addOp<TransposeObj>(t, nullptr, Shape{1, 0})->getOutput();
+        t = g->addOp<CastObj>(t, nullptr, CastType::Float2Int32)->getOutput();
+        t = g->addOp<CastObj>(t, nullptr, CastType::Int322Int64)->getOutput();
+        t = g->addOp<CastObj>(t, nullptr, CastType::Int642Int32)->getOutput();
+        auto y = g->addOp<ConcatObj>(TensorVec{t, t}, nullptr, 0)->getOutput();
+        g->optimize();
+        ASSERT_EQ(g->getOperators().size(), 2u);
+        auto transpose = g->getOperators()[0];
+        EXPECT_EQ(transpose->getOpType(), OpType::Transpose);
+        EXPECT_EQ(transpose->getInputs(0), x);
+        EXPECT_EQ(transpose->getOutDType(), DataType::Int32);
+        EXPECT_EQ(y->getSource()->getInputs(0), transpose->getOutput());
+        EXPECT_TRUE(g->checkValid());
+        g->dataMalloc();
+        x->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(
+            y->equalData(vector<int32_t>{0, 3, 1, 4, 2, 5, 0, 3, 1, 4, 2, 5}));
+
+        // Cast(Relu(x) - x, Float2Int64)：Cast 并入融合算子的写出
+        g = make_ref<GraphObj>(runtime);
+        x = g->addTensor({2, 3}, DataType::Float32);
+        t = g->addOp<ReluObj>(x, nullptr)->getOutput();
+        t = g->addOp<SubObj>(x, t, nullptr)->getOutput();
+        y = g->addOp<CastObj>(t, nullptr, CastType::Float2Int64)->getOutput();
+        g->optimize();
+        ASSERT_EQ(g->getOperators().size(), 1u);
+        auto fused = as<FusedElementWiseObj>(y->getSource());
+        EXPECT_EQ(fused->getProgram().size(), 2u);
+        g->dataMalloc();
+        vector<float> data{-2.5, -1, 0, 0.5, 1.75, 300};
+        std::copy(data.begin(), data.end(), x->getRawDataPtr<float *>());
+        runtime->run(g);
+        EXPECT_TRUE(y->equalData(vector<int64_t>{-2, -1, 0, 0, 0, 0}));
+    }
+
+    TEST(GraphRewrite, ReorderMatmulChain)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        // ((A · B) · C^T) + bias，A(B · C^T) 少算一个 64x64 的中间结果；
+        // UInt32 的乘加满足结合律，结果逐位相同
+        Tensor a, b, c;
+        auto build = [&](Graph g)
+        {
+            a = g->addTensor({3, 64, 2}, DataType::UInt32);
+            b = g->addTensor({2, 64}, DataType::UInt32);
+            c = g->addTensor({2, 64}, DataType::UInt32);
+            Tensor bias = g->addTensor({2}, DataType::UInt32);
+            auto t = g->addOp<MatmulObj>(a, b, nullptr)->getOutput();
+            t = g->addOp<MatmulObj>(t, c, nullptr, false, true)->getOutput();
+            t = g->addOp<AddObj>(t, bias, nullptr)->getOutput();
+            g->dataMalloc();
+            a->setData(IncrementalGenerator());
+            b->setData(IncrementalGenerator());
+            c->setData(IncrementalGenerator());
+            bias->setData(OneGenerator());
+            return t;
+        };
+        Graph ref = make_ref<GraphObj>(runtime);
+        Tensor expected = build(ref);
+        runtime->run(ref);
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor y = build(g);
+        g->optimize();
+        ASSERT_EQ(g->getOperators().size(), 2u);
+        auto root = as<MatmulObj>(y->getSource());
+        EXPECT_EQ(root->getInputs(0), a);
+        EXPECT_NE(root->getBias(), nullptr);
+        auto inner = as<MatmulObj>(root->getInputs(1)->getSource());
+        EXPECT_EQ(inner->getInputs(), (TensorVec{b, c}));
+        EXPECT_FALSE(inner->getTransA());
+        EXPECT_TRUE(inner->getTransB());
+        EXPECT_EQ(inner->getOutput()->getDims(), (Shape{2, 2}));
+        EXPECT_TRUE(g->checkValid());
+        g->dataMalloc();
+        a->setData(IncrementalGenerator());
+        b->setData(IncrementalGenerator());
+        c->setData(IncrementalGenerator());
+        g->getInputs()[3]->setData(OneGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(y->equalData(expected));
+    }
+
+    TEST(GraphRewrite, HorizontalMatmuls)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        // Relu(x · Wq + bq)、Relu(x · Wk + bk)、Relu(x · Wv + bv)，共享 x
+        auto buildShared = [](Graph g, int m)
+        {
+            Tensor x = g->addTensor({m, 4}, DataType::Float32);
+            TensorVec ys;
+            for (int n : {3, 2, 3})
+            {
+                Tensor w = g->addTensor({4, n}, DataType::Float32);
+                Tensor b = g->addTensor({n}, DataType::Float32);
+                w->setWeight();
+                b->setWeight();
+                auto t = g->addOp<MatmulObj>(x, w, nullptr)->getOutput();
+                t = g->addOp<AddObj>(t, b, nullptr)->getOutput();
+                ys.emplace_back(g->addOp<ReluObj>(t, nullptr)->getOutput());
+            }
+            g->dataMalloc();
+            for (auto &input : g->getInputs())
+                input->setData(IncrementalGenerator());
+            return ys;
+        };
+        Graph ref = make_ref<GraphObj>(runtime);
+        auto expected = buildShared(ref, 1);
+        runtime->run(ref);
+        Graph g = make_ref<GraphObj>(runtime);
+        auto ys = buildShared(g, 1);
+        g->optimize();
+        ASSERT_EQ(g->getOperators().size(), 2u);
+        auto split = as<SplitObj>(ys[0]->getSource());
+        EXPECT_EQ(split->getOutputs(), ys);
+        EXPECT_EQ(split->getSizes(), (vector<int>{3, 2, 3}));
+        auto fused = as<MatmulObj>(split->getInputs(0)->getSource());
+        EXPECT_EQ(fused->getInputs(1)->getDims(), (Shape{4, 8}));
+        EXPECT_EQ(fused->getBias()->getDims(), (Shape{8}));
+        EXPECT_EQ(fused->getAct(), ActType::Relu);
+        g->dataMalloc();
+        // 原来的权重和偏置都已回收，只剩拼接后的 [4, 8] 权重和 [8] 偏置
+        EXPECT_EQ(g->getMemoryStats().weightBytes, 0u);
+        EXPECT_EQ(g->getMemoryStats().constantBytes, (4 * 8 + 8) * sizeof(float));
+        // M 为 1，Split 的输出就是 Matmul 结果的连续片段
+        EXPECT_EQ(ys[1]->getRawDataPtr<float *>(),
+                  fused->getOutput()->getRawDataPtr<float *>() + 3);
+        g->getInputs()[0]->setData(IncrementalGenerator());
+        runtime->run(g);
+        for (size_t i = 0; i < ys.size(); ++i)
+            EXPECT_TRUE(ys[i]->equalData(expected[i]));
+
+        // M 大于 1 时 Split 要按行拷贝，不合并，权重也不复制
+        ref = make_ref<GraphObj>(runtime);
+        expected = buildShared(ref, 3);
+        runtime->run(ref);
+        g = make_ref<GraphObj>(runtime);
+        ys = buildShared(g, 3);
+        size_t weightBytes = g->getMemoryStats().weightBytes;
+        g->optimize();
+        ASSERT_EQ(g->getOperators().size(), 3u);
+        for (auto &op : g->getOperators())
+            EXPECT_EQ(op->getOpType(), OpType::MatMul);
+        g->dataMalloc();
+        EXPECT_EQ(g->getMemoryStats().weightBytes, weightBytes);
+        EXPECT_EQ(g->getMemoryStats().constantBytes, 0u);
+        g->getInputs()[0]->setData(IncrementalGenerator());
+        runtime->run(g);
+        for (size_t i = 0; i < ys.size(); ++i)
+            EXPECT_TRUE(ys[i]->equalData(expected[i]));
+
+        // 两个形状相同、互不依赖的 Matmul 合成一个 batched Matmul。A 由
+        // 图中算子产生时，Concat 不需要拷贝；常量 B 在优化时拼接一次
+        auto buildBatched = [](Graph g, bool produced, bool constantB)
+        {
+            TensorVec ys;
+            for (int i = 0; i < 2; ++i)
+            {
+                Tensor a = g->addTensor({2, 3, 4}, DataType::Float32);
+                Tensor b = g->addTensor({2, 4, 5}, DataType::Float32);
+                if (produced)
+                    a = g->addOp<ReluObj>(a, nullptr)->getOutput();
+                if (constantB)
+                    b->setWeight();
+                else if (produced)
+                    b = g->addOp<ReluObj>(b, nullptr)->getOutput();
+                ys.emplace_back(g->addOp<MatmulObj>(a, b, nullptr)->getOutput());
+            }
+            g->dataMalloc();
+            for (auto &input : g->getInputs())
+                input->setData(IncrementalGenerator());
+            return ys;
+        };
+        for (bool constantB : {false, true})
+        {
+            ref = make_ref<GraphObj>(runtime);
+            expected = buildBatched(ref, true, constantB);
+            runtime->run(ref);
+            g = make_ref<GraphObj>(runtime);
+            ys = buildBatched(g, true, constantB);
+            auto inputs = g->getInputs();
+            g->optimize();
+            // Relu ×2 或 ×4、A 的 Concat、B 的 Concat（非常量时）、Matmul、Split
+            ASSERT_EQ(g->getOperators().size(), constantB ? 5u : 8u);
+            split = as<SplitObj>(ys[0]->getSource());
+            EXPECT_EQ(split->getDim(), 0);
+            EXPECT_EQ(split->getInputs(0)->getDims(), (Shape{4, 3, 5}));
+            auto batched = as<MatmulObj>(split->getInputs(0)->getSource());
+            EXPECT_EQ(batched->getInputs(1)->isWeight(), constantB);
+            EXPECT_TRUE(g->checkValid());
+            g->dataMalloc();
+            // Relu 直接写进 Concat 的输出，Split 的输出就是 Matmul 结果的片段
+            auto concatA = batched->getInputs(0);
+            auto reluA = concatA->getSource()->getInputs(1);
+            EXPECT_EQ(reluA->getRawDataPtr<float *>(),
+                      concatA->getRawDataPtr<float *>() + 2 * 3 * 4);
+            EXPECT_EQ(ys[1]->getRawDataPtr<float *>(),
+                      batched->getOutput()->getRawDataPtr<float *>() + 2 * 3 * 5);
+            for (auto &input : inputs)
+                input->setData(IncrementalGenerator());
+            runtime->run(g);
+            for (size_t i = 0; i < ys.size(); ++i)
+                EXPECT_TRUE(ys[i]->equalData(expected[i]));
+        }
+
+        // 操作数是图输入时 Concat 只会多拷贝一份，不合并
+        g = make_ref<GraphObj>(runtime);
+        buildBatched(g, false, false);
+        g->optimize();
+        EXPECT_EQ(g->getOperators().size(), 2u);
+    }
+} // namespace infini
@@ -0,0 +1,44 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+
+#include "test.h"
+#include <fstream>
+
+namespace infini
+{
+    TEST(Runtime, testAlloc)
+    {
+        auto runtime = make_ref<NativeCpuRuntimeObj>();
+        runtime->setAlignment(128);
+        void *ptr = runtime->alloc(100);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % 128, 0u);
+        runtime->dealloc(ptr);
+
+        runtime->setZeroFill(true);
+        auto *data = static_cast<char *>(runtime->alloc(1000));
+        EXPECT_TRUE(std::all_of(data, data + 1000, [](char c)
+                                { return c == 0; }));
+        runtime->dealloc(data);
+    }
+
+    TEST(Runtime, testHugePages)
+    {
+        auto runtime = make_ref<NativeCpuRuntimeObj>();
+        runtime->setHugePageThreshold(4 << 20);
+        size_t size = 8 << 20;
+        auto *data = static_cast<char *>(runtime->alloc(size));
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(data) % (2 << 20), 0u);
+        memset(data, 1, size);
+        size_t hugePageBytes = NativeCpuRuntimeObj::getHugePageBytes(data);
+        runtime->dealloc(data);
+        // whether huge pages are granted depends on the kernel settings
+        std::ifstream thp("/sys/kernel/mm/transparent_hugepage/enabled");
+        string mode;
+        if (!std::getline(thp, mode) ||
+            mode.find("[never]") != string::npos)
+            GTEST_SKIP() << "transparent huge pages are disabled";
+        EXPECT_GT(hugePageBytes, 0u);
+        EXPECT_EQ(hugePageBytes % (2 << 20), 0u);
+    }
+
+} // namespace infini
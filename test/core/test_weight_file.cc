@@ -0,0 +1,262 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "core/weight_file.h"
+#include "operators/element_wise.h"
+#include "operators/matmul.h"
+#include "operators/transpose.h"
+#include "operators/unary.h"
+
+#include "test.h"
+#include <unistd.h>
+
+namespace infini
+{
+    TEST(WeightFile, testLoad)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 3}, DataType::Float32);
+        Tensor w0 = g->addTensor({3}, DataType::Float32);
+        Tensor w1 = g->addTensor({2, 3}, DataType::Float32);
+        w0->setWeight();
+        w1->setWeight();
+        auto add = g->addOp<AddObj>(x, w0, nullptr);
+        auto mul = g->addOp<MulObj>(add->getOutput(), w1, nullptr);
+
+        // export the weights of the graph
+        string path = ::testing::TempDir() + "weights.bin";
+        {
+            Graph exporter = make_ref<GraphObj>(runtime);
+            exporter->addTensor(w0);
+            exporter->addTensor(w1);
+            exporter->dataMalloc();
+            w0->setData(IncrementalGenerator());
+            w1->setData(OneGenerator());
+            WeightFileObj::save(path, {w0, w1});
+        }
+
+        EXPECT_EQ(g->loadWeights(path), 2u);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(w0->getRawDataPtr<void *>()) % 64,
+                  0u);
+        g->dataMalloc();
+        EXPECT_EQ(g->getMemoryStats().weightBytes, 0u);
+        x->setData(OneGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(mul->getOutput()->equalData(vector<float>{1, 2, 3, 1, 2, 3}));
+        unlink(path.c_str());
+    }
+
+    TEST(WeightFile, testLoadIntoFreshGraph)
+    {
+        // Wq and Wk have the same shape, so only the key tells them apart
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        auto build = [&](Graph g)
+        {
+            Tensor x = g->addTensor({2, 3}, DataType::Float32);
+            Tensor wq = g->addTensor({2, 3}, DataType::Float32);
+            Tensor wk = g->addTensor({2, 3}, DataType::Float32);
+            wq->setWeight();
+            wk->setWeight();
+            auto q = g->addOp<MulObj>(x, wq, nullptr)->getOutput();
+            auto k = g->addOp<MulObj>(x, wk, nullptr)->getOutput();
+            return std::make_tuple(x, wq, wk, q, k);
+        };
+
+        string path = ::testing::TempDir() + "weights_fresh.bin";
+        {
+            Graph g = make_ref<GraphObj>(runtime);
+            auto [x, wq, wk, q, k] = build(g);
+            g->dataMalloc();
+            wq->setData(IncrementalGenerator());
+            wk->setData(OneGenerator());
+            g->saveWeights(path);
+        }
+
+        // a fresh graph whose tensors get other FUIDs
+        Graph g = make_ref<GraphObj>(runtime);
+        for (int i = 0; i < 5; ++i)
+            g->addTensor({2, 3}, DataType::Float32);
+        auto [x, wq, wk, q, k] = build(g);
+        EXPECT_EQ(g->loadWeights(path), 2u);
+        g->dataMalloc();
+        x->setData(OneGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(q->equalData(vector<float>{0, 1, 2, 3, 4, 5}));
+        EXPECT_TRUE(k->equalData(vector<float>{1, 1, 1, 1, 1, 1}));
+        unlink(path.c_str());
+    }
+
+    TEST(WeightFile, testRejectDifferentGraph)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        // `wider` changes the shape of a weight, `extra` adds one more
+        auto build = [&](Graph g, bool wider, bool extra)
+        {
+            Tensor x = g->addTensor({2, 3}, DataType::Float32);
+            Tensor wa = g->addTensor({2, 3}, DataType::Float32);
+            Tensor wb = g->addTensor({wider ? 2 : 1, 3}, DataType::Float32);
+            wa->setWeight();
+            wb->setWeight();
+            g->addOp<AddObj>(x, wa, nullptr);
+            g->addOp<MulObj>(x, wb, nullptr);
+            if (extra)
+            {
+                Tensor wc = g->addTensor({2, 3}, DataType::Float32);
+                wc->setWeight();
+                g->addOp<SubObj>(x, wc, nullptr);
+            }
+        };
+
+        string path = ::testing::TempDir() + "weights_different.bin";
+        {
+            Graph g = make_ref<GraphObj>(runtime);
+            build(g, false, false);
+            g->dataMalloc();
+            g->saveWeights(path);
+        }
+        for (auto [wider, extra] : {std::pair{true, false}, {false, true}})
+        {
+            Graph g = make_ref<GraphObj>(runtime);
+            build(g, wider, extra);
+            EXPECT_THROW(g->loadWeights(path), Exception);
+        }
+        unlink(path.c_str());
+    }
+
+    TEST(WeightFile, testLoadAtOtherBatchSize)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        // Relu(x · w + b), x of `batch` rows
+        auto build = [&](Graph g, int batch)
+        {
+            Tensor x = g->addTensor({batch, 4}, DataType::Float32);
+            Tensor w = g->addTensor({4, 3}, DataType::Float32);
+            Tensor b = g->addTensor({3}, DataType::Float32);
+            w->setWeight();
+            b->setWeight();
+            auto t = g->addOp<MatmulObj>(x, w, nullptr)->getOutput();
+            t = g->addOp<AddObj>(t, b, nullptr)->getOutput();
+            return std::make_tuple(x, w, b,
+                                   g->addOp<ReluObj>(t, nullptr)->getOutput());
+        };
+
+        string path = ::testing::TempDir() + "weights_batch.bin";
+        {
+            Graph g = make_ref<GraphObj>(runtime);
+            auto [x, w, b, y] = build(g, 1);
+            g->dataMalloc();
+            w->setData(IncrementalGenerator());
+            b->setData(OneGenerator());
+            g->saveWeights(path);
+        }
+
+        Graph g = make_ref<GraphObj>(runtime);
+        auto [x, w, b, y] = build(g, 4);
+        EXPECT_EQ(g->loadWeights(path), 2u);
+        g->dataMalloc();
+        x->setData(OneGenerator());
+        runtime->run(g);
+        // every row is the column sums of w, 18, 22 and 26, plus 1
+        vector<float> expected;
+        for (int i = 0; i < 4; ++i)
+            expected.insert(expected.end(), {19, 23, 27});
+        EXPECT_TRUE(y->equalData(expected));
+        unlink(path.c_str());
+    }
+
+    TEST(WeightFile, testLoadAfterOptimize)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        // x · T(w0) + w1: optimize folds the Transpose into the Matmul and
+        // the Add into its bias, so both weights get other consumers
+        auto build = [&](Graph g)
+        {
+            Tensor x = g->addTensor({2, 3}, DataType::Float32);
+            Tensor w0 = g->addTensor({2, 3}, DataType::Float32);
+            Tensor w1 = g->addTensor({2}, DataType::Float32);
+            w0->setWeight();
+            w1->setWeight();
+            auto t = g->addOp<TransposeObj>(w0, nullptr, Shape{1, 0});
+            auto m = g->addOp<MatmulObj>(x, t->getOutput(), nullptr);
+            return std::make_tuple(
+                x, w0, w1,
+                g->addOp<AddObj>(m->getOutput(), w1, nullptr)->getOutput());
+        };
+
+        string path = ::testing::TempDir() + "weights_optimize.bin";
+        Graph ref = make_ref<GraphObj>(runtime);
+        auto [rx, rw0, rw1, expected] = build(ref);
+        ref->dataMalloc();
+        rw0->setData(IncrementalGenerator());
+        rw1->setData(OneGenerator());
+        ref->saveWeights(path);
+        rx->setData(IncrementalGenerator());
+        runtime->run(ref);
+
+        Graph g = make_ref<GraphObj>(runtime);
+        auto [x, w0, w1, y] = build(g);
+        g->optimize();
+        ASSERT_EQ(g->getOperators().size(), 1u);
+        EXPECT_EQ(g->loadWeights(path), 2u);
+        g->dataMalloc();
+        x->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(y->equalData(expected));
+        unlink(path.c_str());
+    }
+
+    TEST(WeightFile, testLoadAfterSimplification)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        // (x + zero) * w: optimize erases zero once it holds zeros, which
+        // must not shift w onto the entry of zero
+        auto build = [&](Graph g)
+        {
+            Tensor x = g->addTensor({2, 3}, DataType::Float32);
+            Tensor zero = g->addTensor({2, 3}, DataType::Float32);
+            Tensor w = g->addTensor({2, 3}, DataType::Float32);
+            zero->setWeight();
+            w->setWeight();
+            auto t = g->addOp<AddObj>(x, zero, nullptr)->getOutput();
+            t = g->addOp<MulObj>(t, w, nullptr)->getOutput();
+            return std::make_tuple(x, zero, w,
+                                   g->addOp<ReluObj>(t, nullptr)->getOutput());
+        };
+
+        string before = ::testing::TempDir() + "weights_before.bin";
+        string after = ::testing::TempDir() + "weights_after.bin";
+        {
+            Graph g = make_ref<GraphObj>(runtime);
+            auto [x, zero, w, y] = build(g);
+            g->dataMalloc();
+            zero->setData(ValGenerator<0>());
+            w->setData(IncrementalGenerator());
+            g->saveWeights(before);
+            g->optimize();
+            EXPECT_FALSE(g->hasTensor(zero));
+            g->saveWeights(after);
+        }
+
+        for (auto &path : {before, after})
+        {
+            Graph g = make_ref<GraphObj>(runtime);
+            auto [x, zero, w, y] = build(g);
+            g->dataMalloc();
+            zero->setData(ValGenerator<0>());
+            g->optimize();
+            ASSERT_FALSE(g->hasTensor(zero));
+            EXPECT_EQ(g->loadWeights(path), 1u);
+            g->dataMalloc();
+            x->setData(OneGenerator());
+            runtime->run(g);
+            EXPECT_TRUE(y->equalData(vector<float>{0, 1, 2, 3, 4, 5}));
+        }
+        // the file saved after optimize lacks zero, which the model needs
+        Graph g = make_ref<GraphObj>(runtime);
+        build(g);
+        EXPECT_THROW(g->loadWeights(after), Exception);
+        unlink(before.c_str());
+        unlink(after.c_str());
+    }
+
+} // namespace infini
@@ -0,0 +1,25 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "operators/unary.h"
+
+#include "test.h"
+
+namespace infini {
+
+TEST(Cast, NativeCpu) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto x = g->addTensor({2, 3}, DataType::Float32);
+    auto i = g->addOp<CastObj>(x, nullptr, CastType::Float2Int32)->getOutput();
+    auto l = g->addOp<CastObj>(i, nullptr, CastType::Int322Int64)->getOutput();
+    auto f = g->addOp<CastObj>(l, nullptr, CastType::Int642Float)->getOutput();
+    g->dataMalloc();
+    vector<float> data{-2.5, -1, 0, 0.5, 1.75, 300};
+    std::copy(data.begin(), data.end(), x->getRawDataPtr<float *>());
+    runtime->run(g);
+    // 浮点数转整数向零截断；i 的内存已被 f 复用
+    EXPECT_TRUE(l->equalData(vector<int64_t>{-2, -1, 0, 0, 1, 300}));
+    EXPECT_TRUE(f->equalData(vector<float>{-2, -1, 0, 0, 1, 300}));
+}
+
+} // namespace infini
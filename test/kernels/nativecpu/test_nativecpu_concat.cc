@@ -1,6 +1,7 @@
 #include "core/graph.h"
 #include "core/runtime.h"
 #include "operators/concat.h"
+#include "operators/unary.h"
 
 #include "test.h"
 
@@ -25,4 +26,26 @@ TEST(Concat, NativeCpu) {
                       6, 7, 8, 1, 1, 1, 9, 10, 11, 1, 1, 1}));
 }
 
+TEST(Concat, NativeCpuZeroCopy) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+
+    auto i1 = g->addTensor({1, 2, 3}, DataType::Float32);
+    auto i2 = g->addTensor({1, 1, 3}, DataType::Float32);
+    auto t1 = g->addOp<ReluObj>(i1, nullptr)->getOutput();
+    auto t2 = g->addOp<ReluObj>(i2, nullptr)->getOutput();
+    auto op = g->addOp<ConcatObj>(TensorVec{t1, t2}, nullptr, 1);
+    g->dataMalloc();
+    // the Relu outputs are planned inside the Concat output
+    auto outPtr = op->getOutput()->getRawDataPtr<float *>();
+    EXPECT_EQ(t1->getRawDataPtr<float *>(), outPtr);
+    EXPECT_EQ(t2->getRawDataPtr<float *>(), outPtr + 6);
+    i1->setData(IncrementalGenerator());
+    i2->setData(OneGenerator());
+
+    runtime->run(g);
+    EXPECT_TRUE(
+        op->getOutput()->equalData(vector<float>{0, 1, 2, 3, 4, 5, 1, 1, 1}));
+}
+
 } // namespace infini
@@ -0,0 +1,67 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "operators/element_wise.h"
+#include "operators/fused_element_wise.h"
+#include "operators/unary.h"
+
+#include "test.h"
+
+namespace infini {
+
+// Builds Clip(Relu(x - b) * c, max = 40) / d, with the inputs filled.
+static Tensor buildChain(Graph g, const Shape &x, const Shape &b,
+                         const Shape &c) {
+    auto tx = g->addTensor(x, DataType::Float32);
+    auto tb = g->addTensor(b, DataType::Float32);
+    auto tc = g->addTensor(c, DataType::Float32);
+    auto td = g->addTensor({1}, DataType::Float32);
+    auto t = g->addOp<SubObj>(tx, tb, nullptr)->getOutput();
+    t = g->addOp<ReluObj>(t, nullptr)->getOutput();
+    t = g->addOp<MulObj>(t, tc, nullptr)->getOutput();
+    t = g->addOp<ClipObj>(t, nullptr, std::nullopt, 40.f)->getOutput();
+    t = g->addOp<DivObj>(t, td, nullptr)->getOutput();
+    return t;
+}
+
+static void testFusedChain(const Shape &x, const Shape &b, const Shape &c) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    auto fill = [](Graph g) {
+        auto inputs = g->getInputs();
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (i == 1)
+                inputs[i]->setData(ValGenerator<3>());
+            else if (i == 3)
+                inputs[i]->setData(ValGenerator<2>());
+            else
+                inputs[i]->setData(IncrementalGenerator());
+        }
+    };
+    Graph ref = make_ref<GraphObj>(runtime);
+    auto expected = buildChain(ref, x, b, c);
+    ref->dataMalloc();
+    fill(ref);
+    runtime->run(ref);
+
+    Graph g = make_ref<GraphObj>(runtime);
+    auto y = buildChain(g, x, b, c);
+    g->optimize();
+    ASSERT_EQ(g->getOperators().size(), 1u);
+    auto op = as<FusedElementWiseObj>(g->getOperators()[0]);
+    EXPECT_EQ(op->getProgram().size(), 5u);
+    EXPECT_EQ(op->getOutput(), y);
+    EXPECT_EQ(g->getTensors().size(), 5u);
+    g->dataMalloc();
+    fill(g);
+    runtime->run(g);
+    EXPECT_TRUE(y->equalData(expected));
+}
+
+TEST(FusedElementWise, NativeCpu) {
+    testFusedChain({2, 3, 4}, {3, 1}, {4});
+    // inner loops longer than a block, merged across dimensions
+    testFusedChain({3, 5, 200}, {1}, {5, 200});
+    // broadcast on both sides of the first op
+    testFusedChain({4, 1}, {1, 6}, {1});
+}
+
+} // namespace infini
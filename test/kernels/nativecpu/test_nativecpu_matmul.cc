@@ -0,0 +1,202 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "operators/element_wise.h"
+#include "operators/matmul.h"
+#include "operators/unary.h"
+
+#include "test.h"
+#include <cstdlib>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace infini {
+
+TEST(Matmul, NativeCpu) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    {
+        Graph g = make_ref<GraphObj>(runtime);
+        auto a = g->addTensor({2, 3}, DataType::Float32);
+        auto b = g->addTensor({3, 2}, DataType::Float32);
+        auto op = g->addOp<MatmulObj>(a, b, nullptr);
+        g->dataMalloc();
+        a->setData(IncrementalGenerator());
+        b->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(op->getOutput()->equalData(vector<float>{10, 13, 28, 40}));
+    }
+    {
+        // A^T * B^T, with B broadcast over the batch
+        Graph g = make_ref<GraphObj>(runtime);
+        auto a = g->addTensor({2, 3, 2}, DataType::Float32);
+        auto b = g->addTensor({2, 3}, DataType::Float32);
+        auto op = g->addOp<MatmulObj>(a, b, nullptr, true, true);
+        g->dataMalloc();
+        a->setData(IncrementalGenerator());
+        b->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(op->getOutput()->equalData(
+            vector<float>{10, 28, 13, 40, 28, 100, 31, 112}));
+    }
+}
+
+// Builds Clip(Relu?(A * B + bias)) and checks that optimize() folds the
+// epilogue into the Matmul without changing the result.
+static void testEpilogue(const Shape &bias, bool relu, bool clip) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    auto build = [&](Graph g) {
+        auto a = g->addTensor({2, 3, 4}, DataType::Float32);
+        auto b = g->addTensor({4, 5}, DataType::Float32);
+        auto c = g->addTensor(bias, DataType::Float32);
+        auto t = g->addOp<MatmulObj>(a, b, nullptr)->getOutput();
+        t = g->addOp<AddObj>(c, t, nullptr)->getOutput();
+        if (relu)
+            t = g->addOp<ReluObj>(t, nullptr)->getOutput();
+        if (clip)
+            t = g->addOp<ClipObj>(t, nullptr, 0.f, 120.f)->getOutput();
+        g->dataMalloc();
+        a->setData(IncrementalGenerator());
+        b->setData(IncrementalGenerator());
+        c->setData(IncrementalGenerator());
+        return t;
+    };
+    Graph ref = make_ref<GraphObj>(runtime);
+    auto expected = build(ref);
+    runtime->run(ref);
+
+    Graph g = make_ref<GraphObj>(runtime);
+    auto y = build(g);
+    g->optimize();
+    ASSERT_EQ(g->getOperators().size(), 1u);
+    auto op = as<MatmulObj>(g->getOperators()[0]);
+    EXPECT_EQ(op->getOutput(), y);
+    EXPECT_NE(op->getBias(), nullptr);
+    EXPECT_EQ(op->getAct(), clip   ? ActType::Clip
+                            : relu ? ActType::Relu
+                                   : ActType::None);
+    g->dataMalloc();
+    for (auto &input : g->getInputs())
+        input->setData(IncrementalGenerator());
+    runtime->run(g);
+    EXPECT_TRUE(y->equalData(expected));
+}
+
+TEST(Matmul, NativeCpuEpilogue) {
+    testEpilogue({5}, false, false);
+    testEpilogue({1, 5}, true, false);
+    testEpilogue({3, 1}, false, true);
+    testEpilogue({3, 5}, true, false);
+}
+
+// Runs A * B through the runtime and compares it with a plain triple loop.
+// The inputs are small integers, so float sums are exact at these sizes.
+template <typename T>
+static void testAgainstReference(const Shape &shapeA, const Shape &shapeB,
+                                 bool transA, bool transB, DataType dtype) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto a = g->addTensor(shapeA, dtype);
+    auto b = g->addTensor(shapeB, dtype);
+    auto op = g->addOp<MatmulObj>(a, b, nullptr, transA, transB);
+    g->dataMalloc();
+    auto pattern = [](size_t mod) {
+        return [mod](void *data, size_t size, DataType) {
+            for (size_t i = 0; i < size; ++i)
+                reinterpret_cast<T *>(data)[i] = T(i * 7 % mod);
+        };
+    };
+    a->setData(pattern(5));
+    b->setData(pattern(3));
+    runtime->run(g);
+
+    const size_t m = op->getM(), n = op->getN(), k = op->getK();
+    const T *dataA = a->getRawDataPtr<T *>(), *dataB = b->getRawDataPtr<T *>();
+    auto shapeC = op->getOutput()->getDims();
+    Shape batchC(shapeC.begin(), shapeC.end() - 2);
+    size_t numBatches = op->getOutput()->size() / (m * n);
+    vector<T> expected;
+    for (size_t batch = 0; batch < numBatches; ++batch) {
+        // A and B have at most the batch rank of C; a missing or size-1
+        // dimension broadcasts
+        auto offset = [&](const Shape &shape, size_t matrixSize) {
+            size_t rest = batch, offset = 0, stride = matrixSize;
+            for (size_t i = batchC.size(); i > 0; --i) {
+                size_t idx = rest % batchC[i - 1];
+                rest /= batchC[i - 1];
+                size_t dim = i + shape.size() > batchC.size() + 2
+                                 ? shape[i + shape.size() - batchC.size() - 3]
+                                 : 1;
+                offset += (dim == 1 ? 0 : idx) * stride;
+                stride *= dim;
+            }
+            return offset;
+        };
+        const T *pa = dataA + offset(shapeA, m * k);
+        const T *pb = dataB + offset(shapeB, k * n);
+        for (size_t i = 0; i < m; ++i)
+            for (size_t j = 0; j < n; ++j) {
+                T sum = 0;
+                for (size_t p = 0; p < k; ++p)
+                    sum += (transA ? pa[p * m + i] : pa[i * k + p]) *
+                           (transB ? pb[j * k + p] : pb[p * n + j]);
+                expected.push_back(sum);
+            }
+    }
+    EXPECT_TRUE(op->getOutput()->equalData(expected));
+}
+
+// Shapes that leave partial register tiles and span several cache blocks,
+// under every microkernel the CPU has.
+TEST(Matmul, NativeCpuBlocked) {
+    for (const char *isa : {"generic", "avx2", "avx512"}) {
+        setenv("INFINI_CPU_ISA", isa, 1);
+        for (bool transA : {false, true})
+            for (bool transB : {false, true}) {
+                auto dims = [](bool trans, int rows, int cols) {
+                    return trans ? Shape{cols, rows} : Shape{rows, cols};
+                };
+                testAgainstReference<float>(dims(transA, 151, 300),
+                                            dims(transB, 300, 70), transA,
+                                            transB, DataType::Float32);
+                testAgainstReference<uint32_t>(dims(transA, 7, 33),
+                                               dims(transB, 33, 2050), transA,
+                                               transB, DataType::UInt32);
+            }
+        testAgainstReference<float>({3, 1, 13, 40}, {2, 40, 37}, false, false,
+                                    DataType::Float32);
+        testAgainstReference<uint32_t>({2, 1, 19, 9}, {4, 45, 9}, false, true,
+                                       DataType::UInt32);
+    }
+    unsetenv("INFINI_CPU_ISA");
+}
+
+// M or N of at most 4 take the GEMV path. Four threads split the long K
+// into slices even on a machine with fewer cores.
+TEST(Matmul, NativeCpuSkinny) {
+#ifdef _OPENMP
+    int threads = omp_get_max_threads();
+    omp_set_num_threads(4);
+#endif
+    for (bool transA : {false, true})
+        for (bool transB : {false, true}) {
+            auto dims = [](bool trans, int rows, int cols) {
+                return trans ? Shape{cols, rows} : Shape{rows, cols};
+            };
+            testAgainstReference<float>(dims(transA, 1, 3000),
+                                        dims(transB, 3000, 77), transA, transB,
+                                        DataType::Float32);
+            testAgainstReference<float>(dims(transA, 3, 40),
+                                        dims(transB, 40, 1100), transA, transB,
+                                        DataType::Float32);
+            testAgainstReference<uint32_t>(dims(transA, 600, 2500),
+                                           dims(transB, 2500, 2), transA,
+                                           transB, DataType::UInt32);
+        }
+    testAgainstReference<float>({2, 1, 1, 300}, {3, 300, 50}, false, false,
+                                DataType::Float32);
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+}
+
+} // namespace infini
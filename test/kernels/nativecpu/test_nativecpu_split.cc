@@ -0,0 +1,46 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "operators/split.h"
+#include "operators/unary.h"
+
+#include "test.h"
+
+namespace infini {
+
+TEST(Split, NativeCpu) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+
+    auto t = g->addTensor({2, 5}, DataType::Float32);
+    auto op = g->addOp<SplitObj>(t, std::nullopt, 1, vector<int>{2, 3});
+    g->dataMalloc();
+    t->setData(IncrementalGenerator());
+
+    runtime->run(g);
+    EXPECT_TRUE(op->getOutput(0)->equalData(vector<float>{0, 1, 5, 6}));
+    EXPECT_TRUE(
+        op->getOutput(1)->equalData(vector<float>{2, 3, 4, 7, 8, 9}));
+}
+
+TEST(Split, NativeCpuZeroCopy) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+
+    auto i = g->addTensor({1, 3, 3}, DataType::Float32);
+    auto t = g->addOp<ReluObj>(i, nullptr)->getOutput();
+    auto op = g->addOp<SplitObj>(t, std::nullopt, 1, vector<int>{1, 2});
+    auto r0 = g->addOp<ReluObj>(op->getOutput(0), nullptr)->getOutput();
+    auto r1 = g->addOp<ReluObj>(op->getOutput(1), nullptr)->getOutput();
+    g->dataMalloc();
+    // the outputs are planned inside the input
+    auto inPtr = t->getRawDataPtr<float *>();
+    EXPECT_EQ(op->getOutput(0)->getRawDataPtr<float *>(), inPtr);
+    EXPECT_EQ(op->getOutput(1)->getRawDataPtr<float *>(), inPtr + 3);
+    i->setData(IncrementalGenerator());
+
+    runtime->run(g);
+    EXPECT_TRUE(r0->equalData(vector<float>{0, 1, 2}));
+    EXPECT_TRUE(r1->equalData(vector<float>{3, 4, 5, 6, 7, 8}));
+}
+
+} // namespace infini